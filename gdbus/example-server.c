@@ -267,6 +267,7 @@ on_name_acquired (GDBusConnection *connection,
                                                        "org.gtk.GDBus.TestInterface",
                                                        &introspection_data->interfaces[0],
                                                        &interface_vtable,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        NULL,  /* user_data */
                                                        NULL,  /* user_data_free_func */
                                                        NULL); /* GError** */
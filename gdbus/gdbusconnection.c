@@ -49,6 +49,22 @@
  * TODO: stuff about caching unix_process_id etc. when we add that.
  */
 
+/* Which fields of a signal subscription are set, i.e. not wildcards - used
+ * to partition the signal subscription index
+ */
+typedef enum
+{
+  SIGNAL_MATCH_SENDER         = (1<<0),
+  SIGNAL_MATCH_OBJECT_PATH    = (1<<1),
+  SIGNAL_MATCH_INTERFACE_NAME = (1<<2),
+  SIGNAL_MATCH_MEMBER         = (1<<3),
+  SIGNAL_MATCH_ARG0           = (1<<4),
+  SIGNAL_MATCH_NUM_MASKS      = (1<<5)
+} SignalMatchFlags;
+
+typedef struct _MatchRules MatchRules;
+typedef struct _SignalMessage SignalMessage;
+
 struct _GDBusConnectionPrivate
 {
   DBusConnection *dbus_1_connection;
@@ -64,10 +80,36 @@ struct _GDBusConnectionPrivate
   /* unfortunately there is no dbus_connection_get_exit_on_disconnect() so we need to track this ourselves */
   gboolean exit_on_disconnect;
 
+  /* whether I/O happens in the shared worker thread, see g_dbus_enable_io_worker_thread() */
+  gboolean io_in_worker_thread;
+
+  /* the thread-default context at construction time - used for emitting ::disconnected
+   * when io_in_worker_thread is set
+   */
+  GMainContext *main_context;
+
+  /* see g_dbus_connection_set_dispatch_budget() - 0 means the default */
+  guint dispatch_max_messages;
+  guint dispatch_max_usec;
+
   /* Maps used for signal subscription */
-  GHashTable *map_rule_to_signal_data;
-  GHashTable *map_id_to_signal_data;
-  GHashTable *map_sender_to_signal_data_array;
+  GHashTable *map_match_to_signal_data; /* SignalData* -> SignalData*, hashed on the match fields */
+  GHashTable *map_id_to_signal_data;    /* guint -> SignalData* */
+
+  /* Number of SignalData in map_match_to_signal_data for each SignalMatchFlags mask */
+  guint signal_data_mask_count[SIGNAL_MATCH_NUM_MASKS];
+
+  /* Match rules whose RemoveMatch() call has been deferred, see remove_match_rule() */
+  MatchRules *match_rules;
+
+  /* Sources used for delivering signals to subscribers */
+  GHashTable *map_context_to_signal_source; /* GMainContext* -> SignalDeliverySource* */
+
+  /* Names we dispatch on (subscribed or exported interface and member names) - the
+   * keys are the quark strings so nothing is owned. See message_headers_new_unlocked().
+   */
+  GHashTable *map_name_to_quark; /* const gchar* -> GQuark */
+
 
   /* Maps used for exporting interfaces */
   GHashTable *map_object_path_to_eo; /* gchar* -> ExportedObject* */
@@ -76,8 +118,16 @@ struct _GDBusConnectionPrivate
   /* Map used for exporting subtrees */
   GHashTable *map_object_path_to_es; /* gchar* -> ExportedSubtree* */
   GHashTable *map_id_to_es;          /* guint  -> ExportedSubtree* */
+
+  /* Protects all of the above; taken per connection so a busy connection
+   * never stalls dispatch on other connections in the same process
+   */
+  GStaticMutex lock;
 };
 
+#define CONNECTION_LOCK(connection)   g_static_mutex_lock (&(connection)->priv->lock)
+#define CONNECTION_UNLOCK(connection) g_static_mutex_unlock (&(connection)->priv->lock)
+
 static void         g_dbus_connection_send_dbus_1_message_with_reply           (GDBusConnection    *connection,
                                                                                 DBusMessage        *message,
                                                                                 gint                timeout_msec,
@@ -116,16 +166,181 @@ enum
   PROP_EXIT_ON_DISCONNECT,
 };
 
-static void distribute_signals (GDBusConnection *connection,
-                                DBusMessage     *message);
-
 static void purge_all_signal_subscriptions (GDBusConnection *connection);
 
-G_LOCK_DEFINE_STATIC (connection_lock);
+static void     signal_delivery_source_release (GSource *source);
+static void     signal_message_unref           (SignalMessage *signal_message);
+
+static MatchRules *match_rules_new                       (void);
+static void        match_rules_unref                     (MatchRules     *match_rules);
+static void        match_rules_set_dbus_1_connection     (MatchRules     *match_rules,
+                                                          DBusConnection *dbus_1_connection);
+
+static guint    signal_data_hash  (gconstpointer a);
+static gboolean signal_data_equal (gconstpointer a,
+                                   gconstpointer b);
+
+/* only protects the_session_bus and the_system_bus - per-connection state is
+ * protected by GDBusConnectionPrivate's lock
+ */
+G_LOCK_DEFINE_STATIC (singleton_lock);
 
 static GDBusConnection *the_session_bus = NULL;
 static GDBusConnection *the_system_bus = NULL;
 
+/* set by g_dbus_enable_io_worker_thread() */
+static volatile gint use_io_worker_thread = FALSE;
+
+/* The routing headers of an incoming message, extracted once by filter_function() and
+ * attached to the message so the signal, object and subtree handlers don't walk the
+ * libdbus header fields again. The strings are owned by the message.
+ *
+ * The interface and member names are also looked up as quarks so matching is an integer
+ * comparison. They are looked up in the connection's own map_name_to_quark table rather
+ * than with g_quark_try_string() so we don't take the global quark lock for every
+ * message - a quark of 0 means no-one has subscribed to, or exported, anything with that
+ * name on this connection.
+ *
+ * All connections share one libdbus-1 message data slot. Since the quarks depend on the
+ * connection, each entry records the connection it was parsed for; in the rare case of
+ * several connections wrapping the same DBusConnection, their entries are chained.
+ */
+typedef struct _MessageHeaders MessageHeaders;
+struct _MessageHeaders
+{
+  GDBusConnection *connection; /* not a ref, only used to find our entry */
+  MessageHeaders  *next;
+
+  gint         type;
+  const gchar *sender;
+  const gchar *path;
+  const gchar *interface_name;
+  const gchar *member;
+  GQuark       interface_quark;
+  GQuark       member_quark;
+};
+
+/* libdbus-1 message data slot for MessageHeaders, allocated in class_init() */
+static dbus_int32_t message_headers_slot = -1;
+
+/* well-known names the dispatch code compares against - set up in class_init() */
+static GQuark quark_interface_local;
+static GQuark quark_interface_introspectable;
+static GQuark quark_interface_properties;
+static GQuark quark_member_disconnected;
+static GQuark quark_member_introspect;
+static GQuark quark_member_get;
+static GQuark quark_member_set;
+static GQuark quark_member_get_all;
+
+/* must be called with lock held */
+static GQuark
+intern_name_unlocked (GDBusConnection *connection,
+                      const gchar     *name)
+{
+  GQuark quark;
+
+  quark = g_quark_from_string (name);
+  g_hash_table_insert (connection->priv->map_name_to_quark,
+                       (gpointer) g_quark_to_string (quark),
+                       GUINT_TO_POINTER (quark));
+
+  return quark;
+}
+
+/* must be called with lock held */
+static GQuark
+lookup_name_unlocked (GDBusConnection *connection,
+                      const gchar     *name)
+{
+  if (name == NULL)
+    return 0;
+  return GPOINTER_TO_UINT (g_hash_table_lookup (connection->priv->map_name_to_quark, name));
+}
+
+static void
+message_headers_free (MessageHeaders *headers)
+{
+  while (headers != NULL)
+    {
+      MessageHeaders *next;
+      next = headers->next;
+      g_slice_free (MessageHeaders, headers);
+      headers = next;
+    }
+}
+
+/* must be called with lock held; the returned headers are owned by @message */
+static const MessageHeaders *
+message_headers_new_unlocked (GDBusConnection *connection,
+                              DBusMessage     *message)
+{
+  MessageHeaders *headers;
+  MessageHeaders *first;
+
+  headers = g_slice_new (MessageHeaders);
+  headers->connection = connection;
+  headers->next = NULL;
+  headers->type = dbus_message_get_type (message);
+  headers->sender = dbus_message_get_sender (message);
+  headers->path = dbus_message_get_path (message);
+  headers->interface_name = dbus_message_get_interface (message);
+  headers->member = dbus_message_get_member (message);
+  headers->interface_quark = lookup_name_unlocked (connection, headers->interface_name);
+  headers->member_quark = lookup_name_unlocked (connection, headers->member);
+
+  /* append instead of replacing - dbus_message_set_data() would free the other entries */
+  first = dbus_message_get_data (message, message_headers_slot);
+  if (G_LIKELY (first == NULL))
+    {
+      if (!dbus_message_set_data (message,
+                                  message_headers_slot,
+                                  headers,
+                                  (DBusFreeFunction) message_headers_free))
+        _g_dbus_oom ();
+    }
+  else
+    {
+      while (first->next != NULL)
+        first = first->next;
+      first->next = headers;
+    }
+
+  return headers;
+}
+
+/* libdbus-1 runs filters before object path handlers so filter_function() has always
+ * attached the headers by the time a handler sees the message
+ */
+static const MessageHeaders *
+message_headers_get (GDBusConnection *connection,
+                     DBusMessage     *message)
+{
+  const MessageHeaders *headers;
+
+  headers = dbus_message_get_data (message, message_headers_slot);
+  while (headers != NULL && headers->connection != connection)
+    headers = headers->next;
+  g_assert (headers != NULL);
+
+  return headers;
+}
+
+static gboolean
+message_headers_is_method_call (const MessageHeaders *headers,
+                                GQuark                interface_quark,
+                                GQuark                member_quark)
+{
+  return headers->type == DBUS_MESSAGE_TYPE_METHOD_CALL &&
+    headers->interface_quark == interface_quark &&
+    headers->member_quark == member_quark;
+}
+
+static void distribute_signals_unlocked (GDBusConnection       *connection,
+                                         DBusMessage           *message,
+                                         const MessageHeaders  *headers,
+                                         SignalMessage        **signal_message);
+
 static GObject *g_dbus_connection_constructor (GType                  type,
                                                guint                  n_construct_properties,
                                                GObjectConstructParam *construct_properties);
@@ -153,7 +368,7 @@ g_dbus_connection_dispose (GObject *object)
 {
   GDBusConnection *connection = G_DBUS_CONNECTION (object);
 
-  G_LOCK (connection_lock);
+  G_LOCK (singleton_lock);
   if (connection == the_session_bus)
     {
       the_session_bus = NULL;
@@ -162,7 +377,7 @@ g_dbus_connection_dispose (GObject *object)
     {
       the_system_bus = NULL;
     }
-  G_UNLOCK (connection_lock);
+  G_UNLOCK (singleton_lock);
 
   if (G_OBJECT_CLASS (g_dbus_connection_parent_class)->dispose != NULL)
     G_OBJECT_CLASS (g_dbus_connection_parent_class)->dispose (object);
@@ -175,21 +390,28 @@ g_dbus_connection_finalize (GObject *object)
 
   g_dbus_connection_set_dbus_1_connection (connection, NULL);
 
+  if (connection->priv->main_context != NULL)
+    g_main_context_unref (connection->priv->main_context);
+
   if (connection->priv->initialization_error != NULL)
     g_error_free (connection->priv->initialization_error);
 
   g_free (connection->priv->address);
 
   purge_all_signal_subscriptions (connection);
-  g_hash_table_unref (connection->priv->map_rule_to_signal_data);
+  g_hash_table_unref (connection->priv->map_match_to_signal_data);
   g_hash_table_unref (connection->priv->map_id_to_signal_data);
-  g_hash_table_unref (connection->priv->map_sender_to_signal_data_array);
+  g_hash_table_unref (connection->priv->map_context_to_signal_source);
+  match_rules_unref (connection->priv->match_rules);
+  g_hash_table_unref (connection->priv->map_name_to_quark);
 
   g_hash_table_unref (connection->priv->map_id_to_ei);
   g_hash_table_unref (connection->priv->map_object_path_to_eo);
   g_hash_table_unref (connection->priv->map_id_to_es);
   g_hash_table_unref (connection->priv->map_object_path_to_es);
 
+  g_static_mutex_free (&connection->priv->lock);
+
   if (G_OBJECT_CLASS (g_dbus_connection_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (g_dbus_connection_parent_class)->finalize (object);
 }
@@ -269,6 +491,19 @@ g_dbus_connection_class_init (GDBusConnectionClass *klass)
 
   g_type_class_add_private (klass, sizeof (GDBusConnectionPrivate));
 
+  quark_interface_local          = g_quark_from_static_string (DBUS_INTERFACE_LOCAL);
+  quark_interface_introspectable = g_quark_from_static_string (DBUS_INTERFACE_INTROSPECTABLE);
+  quark_interface_properties     = g_quark_from_static_string (DBUS_INTERFACE_PROPERTIES);
+  quark_member_disconnected      = g_quark_from_static_string ("Disconnected");
+  quark_member_introspect        = g_quark_from_static_string ("Introspect");
+  quark_member_get               = g_quark_from_static_string ("Get");
+  quark_member_set               = g_quark_from_static_string ("Set");
+  quark_member_get_all           = g_quark_from_static_string ("GetAll");
+
+  /* shared by all connections and never freed */
+  if (!dbus_message_allocate_data_slot (&message_headers_slot))
+    _g_dbus_oom ();
+
   gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->constructor  = g_dbus_connection_constructor;
@@ -425,14 +660,33 @@ g_dbus_connection_init (GDBusConnection *connection)
 {
   connection->priv = G_TYPE_INSTANCE_GET_PRIVATE (connection, G_TYPE_DBUS_CONNECTION, GDBusConnectionPrivate);
 
-  connection->priv->map_rule_to_signal_data = g_hash_table_new (g_str_hash,
-                                                                g_str_equal);
+  g_static_mutex_init (&connection->priv->lock);
+
+  connection->priv->io_in_worker_thread = g_atomic_int_get (&use_io_worker_thread);
+  connection->priv->main_context = g_main_context_get_thread_default ();
+  if (connection->priv->main_context != NULL)
+    g_main_context_ref (connection->priv->main_context);
+
+  connection->priv->map_match_to_signal_data = g_hash_table_new (signal_data_hash,
+                                                                 signal_data_equal);
   connection->priv->map_id_to_signal_data = g_hash_table_new (g_direct_hash,
                                                               g_direct_equal);
-  connection->priv->map_sender_to_signal_data_array = g_hash_table_new_full (g_str_hash,
-                                                                             g_str_equal,
-                                                                             g_free,
-                                                                             NULL);
+  connection->priv->match_rules = match_rules_new ();
+  connection->priv->map_context_to_signal_source = g_hash_table_new_full (g_direct_hash,
+                                                                          g_direct_equal,
+                                                                          NULL,
+                                                                          (GDestroyNotify) signal_delivery_source_release);
+
+  connection->priv->map_name_to_quark = g_hash_table_new (g_str_hash,
+                                                          g_str_equal);
+  intern_name_unlocked (connection, DBUS_INTERFACE_LOCAL);
+  intern_name_unlocked (connection, DBUS_INTERFACE_INTROSPECTABLE);
+  intern_name_unlocked (connection, DBUS_INTERFACE_PROPERTIES);
+  intern_name_unlocked (connection, "Disconnected");
+  intern_name_unlocked (connection, "Introspect");
+  intern_name_unlocked (connection, "Get");
+  intern_name_unlocked (connection, "Set");
+  intern_name_unlocked (connection, "GetAll");
 
   connection->priv->map_object_path_to_eo = g_hash_table_new_full (g_str_hash,
                                                                    g_str_equal,
@@ -568,25 +822,78 @@ g_dbus_connection_get_is_private (GDBusConnection *connection)
              dbus_message_get_signature (message));     \
   } while (FALSE)
 
+/* called in the thread-default main loop of the thread that created the connection */
+static gboolean
+handle_disconnect_in_idle_cb (gpointer user_data)
+{
+  GDBusConnection *connection = G_DBUS_CONNECTION (user_data);
+  gboolean emit_signal;
+
+  CONNECTION_LOCK (connection);
+  emit_signal = FALSE;
+  if (connection->priv->dbus_1_connection != NULL)
+    {
+      g_dbus_connection_set_dbus_1_connection (connection, NULL);
+      emit_signal = TRUE;
+    }
+  CONNECTION_UNLOCK (connection);
+
+  if (emit_signal)
+    {
+      g_object_notify (G_OBJECT (connection), "is-disconnected");
+      g_signal_emit (connection, signals[DISCONNECTED_SIGNAL], 0);
+    }
+
+  return FALSE;
+}
+
 static void
 process_message (GDBusConnection *connection,
                  DBusMessage *message)
 {
-  DBusError dbus_error;
+  const MessageHeaders *headers;
+  SignalMessage *signal_message;
+  gboolean is_disconnected;
 
   //g_debug ("in filter_function for dbus_1_connection %p", connection);
   //PRINT_MESSAGE (message);
 
-  dbus_error_init (&dbus_error);
+  signal_message = NULL;
+
+  /* parse the headers and distribute to signal subscribers in one go */
+  CONNECTION_LOCK (connection);
+  headers = message_headers_new_unlocked (connection, message);
   /* check if we are disconnected from the bus */
-  if (dbus_message_is_signal (message,
-                              DBUS_INTERFACE_LOCAL,
-                              "Disconnected") &&
-      dbus_message_get_sender (message) == NULL &&
-      dbus_message_get_destination (message) == NULL &&
-      g_strcmp0 (dbus_message_get_path (message), DBUS_PATH_LOCAL) == 0)
+  is_disconnected = (headers->type == DBUS_MESSAGE_TYPE_SIGNAL &&
+                     headers->interface_quark == quark_interface_local &&
+                     headers->member_quark == quark_member_disconnected &&
+                     headers->sender == NULL &&
+                     dbus_message_get_destination (message) == NULL &&
+                     g_strcmp0 (headers->path, DBUS_PATH_LOCAL) == 0);
+  if (!is_disconnected)
+    distribute_signals_unlocked (connection, message, headers, &signal_message);
+  CONNECTION_UNLOCK (connection);
+
+  if (signal_message != NULL)
+    signal_message_unref (signal_message);
+
+  if (is_disconnected)
     {
-      if (connection->priv->dbus_1_connection != NULL)
+      if (connection->priv->io_in_worker_thread)
+        {
+          GSource *idle_source;
+
+          /* we're in the I/O thread - don't emit ::disconnected here */
+          idle_source = g_idle_source_new ();
+          g_source_set_priority (idle_source, G_PRIORITY_HIGH);
+          g_source_set_callback (idle_source,
+                                 handle_disconnect_in_idle_cb,
+                                 g_object_ref (connection),
+                                 g_object_unref);
+          g_source_attach (idle_source, connection->priv->main_context);
+          g_source_unref (idle_source);
+        }
+      else if (connection->priv->dbus_1_connection != NULL)
         {
           g_dbus_connection_set_dbus_1_connection (connection, NULL);
 
@@ -594,11 +901,6 @@ process_message (GDBusConnection *connection,
           g_signal_emit (connection, signals[DISCONNECTED_SIGNAL], 0);
         }
     }
-  else
-    {
-      /* distribute to signal subscribers */
-      distribute_signals (connection, message);
-    }
 }
 
 static DBusHandlerResult
@@ -621,6 +923,9 @@ g_dbus_connection_set_dbus_1_connection (GDBusConnection *connection,
 {
   g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
 
+  /* this sends pending RemoveMatch() calls so do it before closing the old connection */
+  match_rules_set_dbus_1_connection (connection->priv->match_rules, dbus_1_connection);
+
   if (connection->priv->dbus_1_connection != NULL)
     {
       dbus_connection_remove_filter (connection->priv->dbus_1_connection,
@@ -641,7 +946,8 @@ g_dbus_connection_set_dbus_1_connection (GDBusConnection *connection,
   if (dbus_1_connection != NULL)
     {
       connection->priv->dbus_1_connection = dbus_connection_ref (dbus_1_connection);
-      _g_dbus_integrate_dbus_1_connection (connection->priv->dbus_1_connection, NULL);
+      _g_dbus_integrate_dbus_1_connection (connection->priv->dbus_1_connection,
+                                           connection->priv->io_in_worker_thread ? _g_dbus_get_io_worker_context () : NULL);
       if (!dbus_connection_add_filter (connection->priv->dbus_1_connection,
                                        filter_function,
                                        connection,
@@ -649,6 +955,9 @@ g_dbus_connection_set_dbus_1_connection (GDBusConnection *connection,
         _g_dbus_oom ();
       dbus_connection_set_exit_on_disconnect (connection->priv->dbus_1_connection,
                                               connection->priv->exit_on_disconnect);
+      _g_dbus_set_dbus_1_connection_dispatch_budget (connection->priv->dbus_1_connection,
+                                                     connection->priv->dispatch_max_messages,
+                                                     connection->priv->dispatch_max_usec);
     }
   else
     {
@@ -673,14 +982,14 @@ g_dbus_connection_disconnect (GDBusConnection *connection)
 
   g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
   emit_signal = FALSE;
   if (connection->priv->dbus_1_connection != NULL)
     {
       g_dbus_connection_set_dbus_1_connection (connection, NULL);
       emit_signal = TRUE;
     }
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   if (emit_signal)
     g_signal_emit (connection, signals[DISCONNECTED_SIGNAL], 0);
@@ -702,7 +1011,7 @@ g_dbus_connection_constructor (GType                  type,
   singleton = NULL;
   is_private = FALSE;
 
-  G_LOCK (connection_lock);
+  G_LOCK (singleton_lock);
 
   for (n = 0; n < n_construct_properties; n++)
     {
@@ -775,7 +1084,7 @@ g_dbus_connection_constructor (GType                  type,
     *singleton = G_DBUS_CONNECTION (object);
 
  out:
-  G_UNLOCK (connection_lock);
+  G_UNLOCK (singleton_lock);
   return object;
 }
 
@@ -791,7 +1100,7 @@ initable_init (GInitable       *initable,
   DBusError dbus_error;
   gboolean ret;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   ret = FALSE;
 
@@ -866,7 +1175,7 @@ initable_init (GInitable       *initable,
   connection->priv->is_initialized = TRUE;
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
   return ret;
 }
 
@@ -1290,6 +1599,62 @@ g_dbus_connection_set_exit_on_disconnect (GDBusConnection *connection,
                                             connection->priv->exit_on_disconnect);
 }
 
+/**
+ * g_dbus_enable_io_worker_thread:
+ *
+ * Makes connections created after this call do their socket I/O and
+ * message parsing in a worker thread shared by all such connections,
+ * instead of in the default main loop. This means a busy or blocked
+ * application main loop does not prevent connections from reading
+ * and writing messages.
+ *
+ * Callbacks are still invoked in the same contexts as before: signal
+ * handlers, method call handlers and async results in the thread-default
+ * main loop at the time of subscription, registration or invocation, and
+ * the #GDBusConnection::disconnected signal in the thread-default main
+ * loop at the time the connection was created.
+ *
+ * You must call g_thread_init() and g_dbus_threads_init() before using
+ * this function.
+ **/
+void
+g_dbus_enable_io_worker_thread (void)
+{
+  g_atomic_int_set (&use_io_worker_thread, TRUE);
+}
+
+/**
+ * g_dbus_connection_set_dispatch_budget:
+ * @connection: A #GDBusConnection.
+ * @max_messages: The maximum number of messages to dispatch per main loop iteration or 0 to use the default.
+ * @max_usec: The maximum number of microseconds to spend dispatching messages per main loop iteration or 0 to use the default.
+ *
+ * Sets how much work @connection does each time the main loop it is
+ * integrated with dispatches incoming messages. Once either limit is
+ * reached, remaining messages are left for the next main loop
+ * iteration so other event sources are not starved.
+ *
+ * Large limits drain bursts of messages faster, at the expense of
+ * other sources attached to the same main loop. Passing 1 for
+ * @max_messages dispatches a single message per iteration.
+ **/
+void
+g_dbus_connection_set_dispatch_budget (GDBusConnection *connection,
+                                       guint            max_messages,
+                                       guint            max_usec)
+{
+  g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+
+  CONNECTION_LOCK (connection);
+  connection->priv->dispatch_max_messages = max_messages;
+  connection->priv->dispatch_max_usec = max_usec;
+  if (connection->priv->dbus_1_connection != NULL)
+    _g_dbus_set_dbus_1_connection_dispatch_budget (connection->priv->dbus_1_connection,
+                                                   connection->priv->dispatch_max_messages,
+                                                   connection->priv->dispatch_max_usec);
+  CONNECTION_UNLOCK (connection);
+}
+
 /**
  * g_dbus_connection_get_unique_name:
  * @connection: A #GDBusConnection.
@@ -1347,10 +1712,10 @@ send_dbus_1_message_with_reply_cb (DBusPendingCall *pending_call,
   gulong cancellable_handler_id;
   DBusMessage *reply;
 
-  G_LOCK (connection_lock);
-  cancellable_handler_id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (simple), "cancellable-handler-id"));
   connection = G_DBUS_CONNECTION (g_async_result_get_source_object (G_ASYNC_RESULT (simple)));
-  G_UNLOCK (connection_lock);
+  CONNECTION_LOCK (connection);
+  cancellable_handler_id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (simple), "cancellable-handler-id"));
+  CONNECTION_UNLOCK (connection);
 
   cancellable = g_object_get_data (G_OBJECT (simple), "cancellable");
 
@@ -1413,7 +1778,7 @@ g_dbus_connection_send_dbus_1_message_with_reply (GDBusConnection    *connection
   g_return_if_fail (message != NULL);
   g_return_if_fail (dbus_message_get_type (message) == DBUS_MESSAGE_TYPE_METHOD_CALL);
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   simple = g_simple_async_result_new (G_OBJECT (connection),
                                       callback,
@@ -1490,7 +1855,7 @@ g_dbus_connection_send_dbus_1_message_with_reply (GDBusConnection    *connection
     }
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 }
 
 static DBusMessage *
@@ -1515,13 +1880,72 @@ g_dbus_connection_send_dbus_1_message_with_reply_finish (GDBusConnection   *conn
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* When the connection's I/O happens in the worker thread, synchronous calls wait on a per-call
+ * condition variable while the worker reads and dispatches the reply (or handles the timeout)
+ * instead of making every calling thread contend on libdbus' I/O path. Otherwise nothing
+ * guarantees that anyone is dispatching the context the connection is integrated with, so
+ * dbus_pending_call_block() is used to do the I/O in the calling thread.
+ */
+typedef struct
+{
+  DBusPendingCall *pending_call; /* not a ref */
+
+  GStaticMutex lock;             /* protects the fields below */
+  GCond *cond;                   /* only used with the I/O worker thread */
+  gboolean done;
+  gboolean cancelled;
+} SyncCall;
+
+static void
+sync_call_free (SyncCall *sync_call)
+{
+  if (sync_call->cond != NULL)
+    g_cond_free (sync_call->cond);
+  g_static_mutex_free (&sync_call->lock);
+  g_slice_free (SyncCall, sync_call);
+}
+
+static void
+sync_call_notify_cb (DBusPendingCall *pending_call,
+                     void            *user_data)
+{
+  SyncCall *sync_call = user_data;
+
+  g_static_mutex_lock (&sync_call->lock);
+  sync_call->done = TRUE;
+  if (sync_call->cond != NULL)
+    g_cond_broadcast (sync_call->cond);
+  g_static_mutex_unlock (&sync_call->lock);
+}
+
 static void
 send_dbus_1_message_with_reply_sync_cancelled_cb (GCancellable *cancellable,
                                                   gpointer      user_data)
 {
-  DBusPendingCall *pending_call = user_data;
+  SyncCall *sync_call = user_data;
 
-  dbus_pending_call_cancel (pending_call);
+  dbus_pending_call_cancel (sync_call->pending_call);
+
+  g_static_mutex_lock (&sync_call->lock);
+  sync_call->cancelled = TRUE;
+  if (sync_call->cond != NULL)
+    g_cond_broadcast (sync_call->cond);
+  g_static_mutex_unlock (&sync_call->lock);
+}
+
+static void
+sync_call_wait (SyncCall *sync_call)
+{
+  if (sync_call->cond == NULL)
+    {
+      dbus_pending_call_block (sync_call->pending_call);
+      return;
+    }
+
+  g_static_mutex_lock (&sync_call->lock);
+  while (!sync_call->done && !sync_call->cancelled)
+    g_cond_wait (sync_call->cond, g_static_mutex_get_mutex (&sync_call->lock));
+  g_static_mutex_unlock (&sync_call->lock);
 }
 
 static DBusMessage *
@@ -1534,6 +1958,7 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
   gulong cancellable_handler_id;
   DBusMessage *result;
   DBusPendingCall *pending_call;
+  SyncCall *sync_call;
 
   g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), 0);
   g_return_val_if_fail (message != NULL, 0);
@@ -1541,7 +1966,7 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
 
   result = NULL;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   /* don't even send a message if already cancelled */
   if (g_cancellable_is_cancelled (cancellable))
@@ -1550,7 +1975,7 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
                    G_DBUS_ERROR,
                    G_DBUS_ERROR_CANCELLED,
                    _("Operation was cancelled"));
-      G_UNLOCK (connection_lock);
+      CONNECTION_UNLOCK (connection);
       goto out;
     }
 
@@ -1560,7 +1985,7 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
                    G_DBUS_ERROR,
                    G_DBUS_ERROR_FAILED,
                    _("Not connected"));
-      G_UNLOCK (connection_lock);
+      CONNECTION_UNLOCK (connection);
       goto out;
     }
 
@@ -1576,26 +2001,41 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
                    G_DBUS_ERROR,
                    G_DBUS_ERROR_FAILED,
                    _("Not connected"));
-      G_UNLOCK (connection_lock);
+      CONNECTION_UNLOCK (connection);
       goto out;
     }
 
+  /* freed by libdbus along with the pending call */
+  sync_call = g_slice_new0 (SyncCall);
+  sync_call->pending_call = pending_call;
+  g_static_mutex_init (&sync_call->lock);
+  if (connection->priv->io_in_worker_thread)
+    sync_call->cond = g_cond_new ();
+  dbus_pending_call_set_notify (pending_call,
+                                sync_call_notify_cb,
+                                sync_call,
+                                (DBusFreeFunction) sync_call_free);
+  /* the reply may already have been dispatched by another thread */
+  if (dbus_pending_call_get_completed (pending_call))
+    {
+      g_static_mutex_lock (&sync_call->lock);
+      sync_call->done = TRUE;
+      g_static_mutex_unlock (&sync_call->lock);
+    }
+
   cancellable_handler_id = 0;
   if (cancellable != NULL)
     {
-      /* use the lock to ensure cancellable-handler-id is set on simple before trying to get it
-       * in send_dbus_1_message_with_reply_cb()
-       */
       cancellable_handler_id = g_cancellable_connect (cancellable,
                                                       G_CALLBACK (send_dbus_1_message_with_reply_sync_cancelled_cb),
-                                                      pending_call,
+                                                      sync_call,
                                                       NULL);
     }
 
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
-  /* block without holding the lock */
-  dbus_pending_call_block (pending_call);
+  /* wait without holding the lock */
+  sync_call_wait (sync_call);
 
   if (cancellable_handler_id > 0)
     {
@@ -1603,8 +2043,9 @@ g_dbus_connection_send_dbus_1_message_with_reply_sync (GDBusConnection    *conne
                                 cancellable_handler_id);
     }
 
-  result = dbus_pending_call_steal_reply (pending_call);
-  if (pending_call == NULL)
+  if (dbus_pending_call_get_completed (pending_call))
+    result = dbus_pending_call_steal_reply (pending_call);
+  if (result == NULL)
     {
       g_set_error (error,
                    G_DBUS_ERROR,
@@ -1628,6 +2069,9 @@ typedef struct
   gchar *member;
   gchar *object_path;
   gchar *arg0;
+  /* interface_name and member as quarks - these are what we hash and compare on */
+  GQuark interface_quark;
+  GQuark member_quark;
   GArray *subscribers;
 } SignalData;
 
@@ -1653,6 +2097,55 @@ signal_data_free (SignalData *data)
   g_free (data);
 }
 
+static guint
+signal_data_hash (gconstpointer a)
+{
+  const SignalData *data = a;
+  guint hash;
+
+  hash = data->sender != NULL ? g_str_hash (data->sender) : 0;
+  hash = hash * 31 + (data->object_path != NULL ? g_str_hash (data->object_path) : 0);
+  hash = hash * 31 + data->interface_quark;
+  hash = hash * 31 + data->member_quark;
+  hash = hash * 31 + (data->arg0 != NULL ? g_str_hash (data->arg0) : 0);
+
+  return hash;
+}
+
+static gboolean
+signal_data_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const SignalData *da = a;
+  const SignalData *db = b;
+
+  return g_strcmp0 (da->sender, db->sender) == 0 &&
+    g_strcmp0 (da->object_path, db->object_path) == 0 &&
+    da->interface_quark == db->interface_quark &&
+    da->member_quark == db->member_quark &&
+    g_strcmp0 (da->arg0, db->arg0) == 0;
+}
+
+static guint
+signal_data_get_mask (const SignalData *data)
+{
+  guint mask;
+
+  mask = 0;
+  if (data->sender != NULL)
+    mask |= SIGNAL_MATCH_SENDER;
+  if (data->object_path != NULL)
+    mask |= SIGNAL_MATCH_OBJECT_PATH;
+  if (data->interface_quark != 0)
+    mask |= SIGNAL_MATCH_INTERFACE_NAME;
+  if (data->member_quark != 0)
+    mask |= SIGNAL_MATCH_MEMBER;
+  if (data->arg0 != NULL)
+    mask |= SIGNAL_MATCH_ARG0;
+
+  return mask;
+}
+
 static gchar *
 args_to_rule (const gchar         *sender,
               const gchar         *interface_name,
@@ -1677,44 +2170,106 @@ args_to_rule (const gchar         *sender,
   return g_string_free (rule, FALSE);
 }
 
-static guint _global_subscriber_id = 1;
-static guint _global_registration_id = 1;
-static guint _global_subtree_registration_id = 1;
+/* ids are unique process-wide but the counters are bumped atomically since
+ * each connection only holds its own lock
+ */
+static volatile gint _global_subscriber_id = 1;
+static volatile gint _global_registration_id = 1;
+static volatile gint _global_subtree_registration_id = 1;
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* The match rule state is shared with the idle source sending the deferred
+ * RemoveMatch() calls, so that the source never keeps the connection alive
+ * and it doesn't matter if the context it is attached to is never iterated
+ * again - pending removals are also sent when the connection goes away.
+ */
+struct _MatchRules
+{
+  volatile gint   ref_count;
+
+  /* protects the fields below; nests inside the connection lock */
+  GStaticMutex    lock;
+  DBusConnection *dbus_1_connection; /* NULL if disconnected */
+  GHashTable     *pending_removals;  /* gchar* -> NULL */
+  gboolean        removals_scheduled;
+
+  /* number of calls sent, see _g_dbus_connection_get_match_rule_stats() */
+  guint           num_add_match;
+  guint           num_remove_match;
+};
+
+static MatchRules *
+match_rules_new (void)
+{
+  MatchRules *match_rules;
+
+  match_rules = g_new0 (MatchRules, 1);
+  match_rules->ref_count = 1;
+  g_static_mutex_init (&match_rules->lock);
+  match_rules->pending_removals = g_hash_table_new_full (g_str_hash,
+                                                         g_str_equal,
+                                                         g_free,
+                                                         NULL);
+  return match_rules;
+}
+
+static MatchRules *
+match_rules_ref (MatchRules *match_rules)
+{
+  g_atomic_int_inc (&match_rules->ref_count);
+  return match_rules;
+}
+
 static void
-add_match_cb (DBusPendingCall *pending_call,
-              void            *user_data)
+match_rules_unref (MatchRules *match_rules)
 {
+  if (g_atomic_int_dec_and_test (&match_rules->ref_count))
+    {
+      g_assert (match_rules->dbus_1_connection == NULL);
+      g_hash_table_unref (match_rules->pending_removals);
+      g_static_mutex_free (&match_rules->lock);
+      g_free (match_rules);
+    }
+}
+
+static void
+add_match_reply_cb (DBusPendingCall *pending_call,
+                    void            *user_data)
+{
+  const gchar *match_rule = user_data;
   DBusMessage *reply;
   DBusError dbus_error;
 
   reply = dbus_pending_call_steal_reply (pending_call);
-  g_assert (reply != NULL);
+  if (reply == NULL)
+    return;
 
   dbus_error_init (&dbus_error);
   if (dbus_set_error_from_message (&dbus_error, reply))
     {
-      if (g_strcmp0 (dbus_error.name, "org.freedesktop.DBus.Error.OOM") == 0)
-        {
-          g_critical ("Message bus reported OOM when trying to add match rule: %s: %s",
-                      dbus_error.name,
-                      dbus_error.message);
-          _g_dbus_oom ();
-        }
-
-      /* Don't report other errors; the bus might have gone away while sending the message
-       * so @dbus_error might be a locally generated error.
-       */
-
+      /* losing the connection is reported elsewhere */
+      if (!dbus_error_has_name (&dbus_error, DBUS_ERROR_NO_REPLY) &&
+          !dbus_error_has_name (&dbus_error, DBUS_ERROR_DISCONNECTED))
+        g_warning ("The bus rejected the match rule `%s': %s: %s",
+                   match_rule,
+                   dbus_error.name,
+                   dbus_error.message);
       dbus_error_free (&dbus_error);
     }
+  dbus_message_unref (reply);
 }
 
+/* Match rules are sent without waiting for the reply so a proxy-heavy startup pipelines its
+ * AddMatch() calls. The bus can refuse AddMatch() - e.g. with LimitsExceeded or
+ * MatchRuleInvalid - and then the subscriber silently gets no signals, so we still look at the
+ * reply and log failures. RemoveMatch() can only fail if the rule doesn't exist, which there
+ * is nothing sensible to do about, so it doesn't ask for a reply at all.
+ */
 static void
-add_match_rule (GDBusConnection *connection,
-                const gchar     *match_rule)
+send_match_rule (DBusConnection *dbus_1_connection,
+                 const gchar    *method_name,
+                 const gchar    *match_rule)
 {
   DBusMessage *message;
   DBusPendingCall *pending_call;
@@ -1722,84 +2277,169 @@ add_match_rule (GDBusConnection *connection,
   if ((message = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
                                                DBUS_PATH_DBUS,
                                                DBUS_INTERFACE_DBUS,
-                                               "AddMatch")) == NULL)
+                                               method_name)) == NULL)
     _g_dbus_oom ();
   if (!dbus_message_append_args (message,
                                  DBUS_TYPE_STRING, &match_rule,
                                  DBUS_TYPE_INVALID))
     _g_dbus_oom ();
 
-  /* don't use g_dbus_connection_send_dbus_1_message_with_reply() since we don't want to ref @connection */
-  if (!dbus_connection_send_with_reply (connection->priv->dbus_1_connection,
-                                        message,
-                                        &pending_call,
-                                        -1))
-    _g_dbus_oom ();
-
-  dbus_pending_call_set_notify (pending_call,
-                                add_match_cb,
-                                NULL,
-                                NULL);
+  if (g_strcmp0 (method_name, "AddMatch") == 0)
+    {
+      if (!dbus_connection_send_with_reply (dbus_1_connection,
+                                            message,
+                                            &pending_call,
+                                            -1))
+        _g_dbus_oom ();
+      /* NULL if we are disconnected */
+      if (pending_call != NULL)
+        {
+          if (!dbus_pending_call_set_notify (pending_call,
+                                             add_match_reply_cb,
+                                             g_strdup (match_rule),
+                                             g_free))
+            _g_dbus_oom ();
+          dbus_pending_call_unref (pending_call);
+        }
+    }
+  else
+    {
+      dbus_message_set_no_reply (message, TRUE);
+      if (!dbus_connection_send (dbus_1_connection,
+                                 message,
+                                 NULL))
+        _g_dbus_oom ();
+    }
 
   dbus_message_unref (message);
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
-
+/* must hold match_rules->lock when calling this */
 static void
-remove_match_cb (DBusPendingCall *pending_call,
-                 void            *user_data)
+match_rules_flush_removals_unlocked (MatchRules *match_rules)
 {
-  DBusMessage *reply;
-  DBusError dbus_error;
-
-  reply = dbus_pending_call_steal_reply (pending_call);
-  g_assert (reply != NULL);
+  GHashTableIter iter;
+  const gchar *match_rule;
 
-  dbus_error_init (&dbus_error);
-  if (dbus_set_error_from_message (&dbus_error, reply))
+  if (match_rules->dbus_1_connection != NULL)
     {
-      if (g_strcmp0 (dbus_error.name, "org.freedesktop.DBus.Error.MatchRuleNotFound") == 0)
+      g_hash_table_iter_init (&iter, match_rules->pending_removals);
+      while (g_hash_table_iter_next (&iter, (gpointer) &match_rule, NULL))
         {
-          g_warning ("Message bus reported error removing match rule: %s: %s\n"
-                     "This is a bug in GDBus.",
-                     dbus_error.name,
-                     dbus_error.message);
+          send_match_rule (match_rules->dbus_1_connection, "RemoveMatch", match_rule);
+          match_rules->num_remove_match++;
         }
-      dbus_error_free (&dbus_error);
     }
+  g_hash_table_remove_all (match_rules->pending_removals);
 }
 
+/* Called whenever the connection's DBusConnection changes. Pending removals are sent
+ * right away since the bus only drops our match rules when the connection is closed
+ * and shared connections never are.
+ */
 static void
-remove_match_rule (GDBusConnection *connection,
-                   const gchar     *match_rule)
+match_rules_set_dbus_1_connection (MatchRules     *match_rules,
+                                   DBusConnection *dbus_1_connection)
 {
-  DBusMessage *message;
-  DBusPendingCall *pending_call;
+  g_static_mutex_lock (&match_rules->lock);
+  match_rules_flush_removals_unlocked (match_rules);
+  if (match_rules->dbus_1_connection != NULL)
+    dbus_connection_unref (match_rules->dbus_1_connection);
+  match_rules->dbus_1_connection = dbus_1_connection != NULL ? dbus_connection_ref (dbus_1_connection) : NULL;
+  g_static_mutex_unlock (&match_rules->lock);
+}
 
-  if ((message = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
-                                               DBUS_PATH_DBUS,
-                                               DBUS_INTERFACE_DBUS,
-                                               "RemoveMatch")) == NULL)
-    _g_dbus_oom ();
-  if (!dbus_message_append_args (message,
-                                 DBUS_TYPE_STRING, &match_rule,
-                                 DBUS_TYPE_INVALID))
-    _g_dbus_oom ();
+/* must hold lock when calling this */
+static void
+add_match_rule (GDBusConnection *connection,
+                const gchar     *match_rule)
+{
+  MatchRules *match_rules = connection->priv->match_rules;
 
-  /* don't use g_dbus_connection_send_dbus_1_message_with_reply() since we don't want to ref @connection */
-  if (!dbus_connection_send_with_reply (connection->priv->dbus_1_connection,
-                                        message,
-                                        &pending_call,
-                                        -1))
-    _g_dbus_oom ();
+  g_static_mutex_lock (&match_rules->lock);
 
-  dbus_pending_call_set_notify (pending_call,
-                                remove_match_cb,
-                                NULL,
-                                NULL);
+  /* If we've been asked to remove the rule but haven't done so yet, just keep it. Need to
+   * send AddMatch() right away otherwise since signals emitted after subscribing must
+   * reach us.
+   */
+  if (g_hash_table_remove (match_rules->pending_removals, match_rule))
+    goto out;
 
-  dbus_message_unref (message);
+  if (match_rules->dbus_1_connection != NULL)
+    {
+      send_match_rule (match_rules->dbus_1_connection, "AddMatch", match_rule);
+      match_rules->num_add_match++;
+    }
+
+ out:
+  g_static_mutex_unlock (&match_rules->lock);
+}
+
+static gboolean
+remove_match_rules_in_idle_cb (gpointer user_data)
+{
+  MatchRules *match_rules = user_data;
+
+  g_static_mutex_lock (&match_rules->lock);
+  match_rules_flush_removals_unlocked (match_rules);
+  match_rules->removals_scheduled = FALSE;
+  g_static_mutex_unlock (&match_rules->lock);
+
+  return FALSE;
+}
+
+/* must hold lock when calling this; @context is the context of the subscriber going away */
+static void
+remove_match_rule (GDBusConnection *connection,
+                   const gchar     *match_rule,
+                   GMainContext    *context)
+{
+  MatchRules *match_rules = connection->priv->match_rules;
+  GSource *idle_source;
+
+  /* Defer the RemoveMatch() until the main loop is idle - there's no harm in receiving a few
+   * more signals (they're dropped when no-one is subscribed) and this way a rule that is
+   * subscribed to again in the meantime never hits the bus. Also batches all removals.
+   */
+  g_static_mutex_lock (&match_rules->lock);
+  g_hash_table_insert (match_rules->pending_removals,
+                       g_strdup (match_rule),
+                       NULL);
+
+  if (!match_rules->removals_scheduled)
+    {
+      idle_source = g_idle_source_new ();
+      g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
+      g_source_set_callback (idle_source,
+                             remove_match_rules_in_idle_cb,
+                             match_rules_ref (match_rules),
+                             (GDestroyNotify) match_rules_unref);
+      g_source_attach (idle_source, context);
+      g_source_unref (idle_source);
+      match_rules->removals_scheduled = TRUE;
+    }
+  g_static_mutex_unlock (&match_rules->lock);
+}
+
+/**
+ * _g_dbus_connection_get_match_rule_stats:
+ * @connection: A #GDBusConnection.
+ * @out_num_add_match: Return location for the number of AddMatch() calls sent.
+ * @out_num_remove_match: Return location for the number of RemoveMatch() calls sent.
+ *
+ * Only for use by the test suite.
+ */
+void
+_g_dbus_connection_get_match_rule_stats (GDBusConnection *connection,
+                                         guint           *out_num_add_match,
+                                         guint           *out_num_remove_match)
+{
+  MatchRules *match_rules = connection->priv->match_rules;
+
+  g_static_mutex_lock (&match_rules->lock);
+  *out_num_add_match = match_rules->num_add_match;
+  *out_num_remove_match = match_rules->num_remove_match;
+  g_static_mutex_unlock (&match_rules->lock);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1856,13 +2496,12 @@ g_dbus_connection_signal_subscribe (GDBusConnection     *connection,
                                     gpointer             user_data,
                                     GDestroyNotify       user_data_free_func)
 {
-  gchar *rule;
+  SignalData key;
   SignalData *signal_data;
   SignalSubscriber subscriber;
-  GPtrArray *signal_data_array;
 
-  /* Right now we abort if AddMatch() fails since it can only fail with the bus being in
-   * an OOM condition. We might want to change that but that would involve making
+  /* Right now we don't check whether AddMatch() fails since it can only fail with the bus
+   * being in an OOM condition. We might want to change that but that would involve making
    * g_dbus_connection_signal_subscribe() asynchronous and having the call sites
    * handle that. And there's really no sensible way of handling this short of retrying
    * to add the match rule... and then there's the little thing that, hey, maybe there's
@@ -1878,43 +2517,47 @@ g_dbus_connection_signal_subscribe (GDBusConnection     *connection,
   g_return_val_if_fail (callback != NULL, 0);
   /* TODO: check that passed in data is well-formed */
 
-  G_LOCK (connection_lock);
-
-  rule = args_to_rule (sender, interface_name, member, object_path, arg0);
-
-  if (sender == NULL)
-    sender = "";
+  CONNECTION_LOCK (connection);
 
   subscriber.callback = callback;
   subscriber.user_data = user_data;
   subscriber.user_data_free_func = user_data_free_func;
-  subscriber.id = _global_subscriber_id++; /* TODO: overflow etc. */
+  subscriber.id = g_atomic_int_exchange_and_add (&_global_subscriber_id, 1); /* TODO: overflow etc. */
   subscriber.context = g_main_context_get_thread_default ();
   if (subscriber.context != NULL)
     g_main_context_ref (subscriber.context);
 
   /* see if we've already have this rule */
-  signal_data = g_hash_table_lookup (connection->priv->map_rule_to_signal_data, rule);
+  key.sender          = (gchar *) sender;
+  key.interface_name  = (gchar *) interface_name;
+  key.member          = (gchar *) member;
+  key.object_path     = (gchar *) object_path;
+  key.arg0            = (gchar *) arg0;
+  key.interface_quark = interface_name != NULL ? intern_name_unlocked (connection, interface_name) : 0;
+  key.member_quark    = member != NULL ? intern_name_unlocked (connection, member) : 0;
+  signal_data = g_hash_table_lookup (connection->priv->map_match_to_signal_data, &key);
   if (signal_data != NULL)
     {
       g_array_append_val (signal_data->subscribers, subscriber);
-      g_free (rule);
       goto out;
     }
 
   signal_data = g_new0 (SignalData, 1);
-  signal_data->rule           = rule;
+  signal_data->rule           = args_to_rule (sender, interface_name, member, object_path, arg0);
   signal_data->sender         = g_strdup (sender);
   signal_data->interface_name = g_strdup (interface_name);
   signal_data->member         = g_strdup (member);
   signal_data->object_path    = g_strdup (object_path);
   signal_data->arg0           = g_strdup (arg0);
+  signal_data->interface_quark = key.interface_quark;
+  signal_data->member_quark   = key.member_quark;
   signal_data->subscribers    = g_array_new (FALSE, FALSE, sizeof (SignalSubscriber));
   g_array_append_val (signal_data->subscribers, subscriber);
 
-  g_hash_table_insert (connection->priv->map_rule_to_signal_data,
-                       signal_data->rule,
+  g_hash_table_insert (connection->priv->map_match_to_signal_data,
+                       signal_data,
                        signal_data);
+  connection->priv->signal_data_mask_count[signal_data_get_mask (signal_data)]++;
 
   /* Add the match rule to the bus...
    *
@@ -1934,18 +2577,7 @@ g_dbus_connection_signal_subscribe (GDBusConnection     *connection,
                        GUINT_TO_POINTER (subscriber.id),
                        signal_data);
 
-  signal_data_array = g_hash_table_lookup (connection->priv->map_sender_to_signal_data_array,
-                                           signal_data->sender);
-  if (signal_data_array == NULL)
-    {
-      signal_data_array = g_ptr_array_new ();
-      g_hash_table_insert (connection->priv->map_sender_to_signal_data_array,
-                           g_strdup (signal_data->sender),
-                           signal_data_array);
-    }
-  g_ptr_array_add (signal_data_array, signal_data);
-
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   return subscriber.id;
 }
@@ -1959,7 +2591,6 @@ unsubscribe_id_internal (GDBusConnection    *connection,
                          GArray             *out_removed_subscribers)
 {
   SignalData *signal_data;
-  GPtrArray *signal_data_array;
   guint n;
 
   signal_data = g_hash_table_lookup (connection->priv->map_id_to_signal_data,
@@ -1973,6 +2604,7 @@ unsubscribe_id_internal (GDBusConnection    *connection,
   for (n = 0; n < signal_data->subscribers->len; n++)
     {
       SignalSubscriber *subscriber;
+      GMainContext *context;
 
       subscriber = &(g_array_index (signal_data->subscribers, SignalSubscriber, n));
       if (subscriber->id != subscription_id)
@@ -1980,20 +2612,14 @@ unsubscribe_id_internal (GDBusConnection    *connection,
 
       g_assert (g_hash_table_remove (connection->priv->map_id_to_signal_data,
                                      GUINT_TO_POINTER (subscription_id)));
+      context = subscriber->context;
       g_array_append_val (out_removed_subscribers, *subscriber);
       g_array_remove_index (signal_data->subscribers, n);
 
       if (signal_data->subscribers->len == 0)
-        g_assert (g_hash_table_remove (connection->priv->map_rule_to_signal_data, signal_data->rule));
-
-      signal_data_array = g_hash_table_lookup (connection->priv->map_sender_to_signal_data_array,
-                                               signal_data->sender);
-      g_assert (signal_data_array != NULL);
-      g_assert (g_ptr_array_remove (signal_data_array, signal_data));
-
-      if (signal_data_array->len == 0)
         {
-          g_assert (g_hash_table_remove (connection->priv->map_sender_to_signal_data_array, signal_data->sender));
+          g_assert (g_hash_table_remove (connection->priv->map_match_to_signal_data, signal_data));
+          connection->priv->signal_data_mask_count[signal_data_get_mask (signal_data)]--;
 
           /* remove the match rule from the bus unless NameLost or NameAcquired (see subscribe()) */
           if (connection->priv->bus_type != G_BUS_TYPE_NONE)
@@ -2002,7 +2628,7 @@ unsubscribe_id_internal (GDBusConnection    *connection,
                 {
                   if (connection->priv->dbus_1_connection != NULL)
                     {
-                      remove_match_rule (connection, signal_data->rule);
+                      remove_match_rule (connection, signal_data->rule, context);
                     }
                 }
             }
@@ -2035,11 +2661,11 @@ g_dbus_connection_signal_unsubscribe (GDBusConnection    *connection,
 
   subscribers = g_array_new (FALSE, FALSE, sizeof (SignalSubscriber));
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
   unsubscribe_id_internal (connection,
                            subscription_id,
                            subscribers);
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   /* invariant */
   g_assert (subscribers->len == 0 || subscribers->len == 1);
@@ -2060,24 +2686,63 @@ g_dbus_connection_signal_unsubscribe (GDBusConnection    *connection,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-typedef struct
+/* A received signal, shared by all SignalInstance objects for it. The
+ * parameters are converted to a GVariant at most once, by whichever
+ * subscriber runs first, and the (immutable) result is handed to every
+ * subscriber.
+ */
+struct _SignalMessage
 {
-  GDBusSignalCallback  callback;
-  gpointer             user_data;
-  DBusMessage         *message;
-  GDBusConnection     *connection;
-} SignalInstance;
+  volatile gint   ref_count;
+  DBusMessage    *message;
+  MessageHeaders  headers;
+  GOnce           parameters_once;
+};
 
-static gboolean
-emit_signal_instance_in_idle_cb (gpointer data)
+static SignalMessage *
+signal_message_new (DBusMessage          *message,
+                    const MessageHeaders *headers)
+{
+  SignalMessage *signal_message;
+
+  signal_message = g_slice_new (SignalMessage);
+  signal_message->ref_count = 1;
+  signal_message->message = dbus_message_ref (message);
+  signal_message->headers = *headers;
+  signal_message->parameters_once.status = G_ONCE_STATUS_NOTCALLED;
+  signal_message->parameters_once.retval = NULL;
+
+  return signal_message;
+}
+
+static SignalMessage *
+signal_message_ref (SignalMessage *signal_message)
+{
+  g_atomic_int_inc (&signal_message->ref_count);
+  return signal_message;
+}
+
+static void
+signal_message_unref (SignalMessage *signal_message)
 {
-  SignalInstance *signal_instance = data;
+  if (g_atomic_int_dec_and_test (&signal_message->ref_count))
+    {
+      if (signal_message->parameters_once.retval != NULL)
+        g_variant_unref (signal_message->parameters_once.retval);
+      dbus_message_unref (signal_message->message);
+      g_slice_free (SignalMessage, signal_message);
+    }
+}
 
+static gpointer
+signal_message_convert_parameters (gpointer data)
+{
+  SignalMessage *signal_message = data;
   GVariant *parameters;
   GError *error;
 
   error = NULL;
-  parameters = _g_dbus_dbus_1_to_gvariant (signal_instance->message, &error);
+  parameters = _g_dbus_dbus_1_to_gvariant (signal_message->message, &error);
   if (parameters == NULL)
     {
       g_warning ("Error converting signal parameters to a GVariant: %s", error->message);
@@ -2085,121 +2750,323 @@ emit_signal_instance_in_idle_cb (gpointer data)
       goto out;
     }
 
+ out:
+  return parameters;
+}
+
+/* Returns: (transfer none): the parameters of @signal_message or %NULL if they couldn't be converted */
+static GVariant *
+signal_message_get_parameters (SignalMessage *signal_message)
+{
+  return g_once (&signal_message->parameters_once,
+                 signal_message_convert_parameters,
+                 signal_message);
+}
+
+typedef struct
+{
+  GDBusSignalCallback  callback;
+  gpointer             user_data;
+  SignalMessage       *signal_message;
+  GDBusConnection     *connection;
+} SignalInstance;
+
+static void
+emit_signal_instance (SignalInstance *signal_instance)
+{
+  const MessageHeaders *headers;
+  GVariant *parameters;
+
+  parameters = signal_message_get_parameters (signal_instance->signal_message);
+  if (parameters == NULL)
+    goto out;
+
+  headers = &signal_instance->signal_message->headers;
   signal_instance->callback (signal_instance->connection,
-                             dbus_message_get_sender (signal_instance->message),
-                             dbus_message_get_path (signal_instance->message),
-                             dbus_message_get_interface (signal_instance->message),
-                             dbus_message_get_member (signal_instance->message),
+                             headers->sender,
+                             headers->path,
+                             headers->interface_name,
+                             headers->member,
                              parameters,
                              signal_instance->user_data);
- out:
-  g_variant_unref (parameters);
 
-  return FALSE;
+ out:
+  ;
 }
 
 static void
 signal_instance_free (SignalInstance *signal_instance)
 {
-  dbus_message_unref (signal_instance->message);
+  signal_message_unref (signal_instance->signal_message);
   g_object_unref (signal_instance->connection);
-  g_free (signal_instance);
+  g_slice_free (SignalInstance, signal_instance);
 }
 
-static void
-schedule_callbacks (GDBusConnection *connection,
-                    GPtrArray       *signal_data_array,
-                    DBusMessage     *message)
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Each connection has one persistent SignalDeliverySource per GMainContext
+ * that subscribers live in. Matched signals are queued on it and what is
+ * queued is delivered in a single dispatch, instead of creating and
+ * attaching an idle source for every (subscriber, message) pair. The
+ * source can recurse so a callback running a nested main loop still gets
+ * the signals queued behind it.
+ */
+typedef struct
 {
-  guint n, m;
+  GSource       source;
 
-  /* TODO: if this is slow, then we can change signal_data_array into
-   *       map_object_path_to_signal_data_array or something.
+  /* protects pending; we can't use the connection lock since the source
+   * may outlive the connection
    */
-  for (n = 0; n < signal_data_array->len; n++)
-    {
-      SignalData *signal_data = signal_data_array->pdata[n];
-      const gchar *arg0;
+  GStaticMutex  lock;
+  GQueue        pending; /* of SignalInstance* */
+} SignalDeliverySource;
 
-      if (signal_data->interface_name != NULL &&
-          g_strcmp0 (signal_data->interface_name, dbus_message_get_interface (message)) != 0)
-        continue;
+static gboolean
+signal_delivery_source_prepare (GSource *source,
+                                gint    *timeout)
+{
+  SignalDeliverySource *delivery_source = (SignalDeliverySource *) source;
+  gboolean ret;
 
-      if (signal_data->member != NULL &&
-          g_strcmp0 (signal_data->member, dbus_message_get_member (message)) != 0)
-        continue;
+  *timeout = -1;
 
-      if (signal_data->object_path != NULL &&
-          g_strcmp0 (signal_data->object_path, dbus_message_get_path (message)) != 0)
-        continue;
+  g_static_mutex_lock (&delivery_source->lock);
+  ret = !g_queue_is_empty (&delivery_source->pending);
+  g_static_mutex_unlock (&delivery_source->lock);
 
-      if (signal_data->arg0 != NULL)
-        {
-          if (!dbus_message_get_args (message,
-                                      NULL,
-                                      DBUS_TYPE_STRING, &arg0,
-                                      DBUS_TYPE_INVALID))
-            continue;
+  return ret;
+}
 
-          if (g_strcmp0 (signal_data->arg0, arg0) != 0)
-            continue;
-        }
+static gboolean
+signal_delivery_source_check (GSource *source)
+{
+  gint timeout;
+  return signal_delivery_source_prepare (source, &timeout);
+}
 
-      for (m = 0; m < signal_data->subscribers->len; m++)
-        {
-          SignalSubscriber *subscriber;
-          GSource *idle_source;
-          SignalInstance *signal_instance;
+static gboolean
+signal_delivery_source_dispatch (GSource     *source,
+                                 GSourceFunc  callback,
+                                 gpointer     user_data)
+{
+  SignalDeliverySource *delivery_source = (SignalDeliverySource *) source;
+  SignalInstance *signal_instance;
+  guint num_pending;
+  guint n;
+
+  /* only deliver what is queued so far - signals queued while we're running
+   * callbacks are handled in the next iteration. Instances are popped one
+   * at a time so a nested dispatch from a callback continues in order.
+   */
+  g_static_mutex_lock (&delivery_source->lock);
+  num_pending = g_queue_get_length (&delivery_source->pending);
+  g_static_mutex_unlock (&delivery_source->lock);
 
-          subscriber = &(g_array_index (signal_data->subscribers, SignalSubscriber, m));
+  for (n = 0; n < num_pending; n++)
+    {
+      g_static_mutex_lock (&delivery_source->lock);
+      signal_instance = g_queue_pop_head (&delivery_source->pending);
+      g_static_mutex_unlock (&delivery_source->lock);
 
-          signal_instance = g_new0 (SignalInstance, 1);
-          signal_instance->callback = subscriber->callback;
-          signal_instance->user_data = subscriber->user_data;
-          signal_instance->message = dbus_message_ref (message);
-          signal_instance->connection = g_object_ref (connection);
+      if (signal_instance == NULL)
+        break;
 
-          /* use higher priority that method_reply to ensure signals are handled before method replies */
-          idle_source = g_idle_source_new ();
-          g_source_set_priority (idle_source, G_PRIORITY_HIGH);
-          g_source_set_callback (idle_source,
-                                 emit_signal_instance_in_idle_cb,
-                                 signal_instance,
-                                 (GDestroyNotify) signal_instance_free);
-          g_source_attach (idle_source, subscriber->context);
-          g_source_unref (idle_source);
-        }
+      emit_signal_instance (signal_instance);
+      signal_instance_free (signal_instance);
     }
+
+  return TRUE;
 }
 
-/* do not call with any locks held */
 static void
-distribute_signals (GDBusConnection *connection,
-                    DBusMessage     *message)
+signal_delivery_source_finalize (GSource *source)
 {
-  const gchar *sender;
-  GPtrArray *signal_data_array;
+  SignalDeliverySource *delivery_source = (SignalDeliverySource *) source;
+  SignalInstance *signal_instance;
 
-  sender = dbus_message_get_sender (message);
+  while ((signal_instance = g_queue_pop_head (&delivery_source->pending)) != NULL)
+    signal_instance_free (signal_instance);
+  g_static_mutex_free (&delivery_source->lock);
+}
 
-  G_LOCK (connection_lock);
+static GSourceFuncs signal_delivery_source_funcs =
+{
+  signal_delivery_source_prepare,
+  signal_delivery_source_check,
+  signal_delivery_source_dispatch,
+  signal_delivery_source_finalize
+};
 
-  /* collect subcsribers that match on sender */
-  if (sender != NULL)
+static void
+signal_delivery_source_release (GSource *source)
+{
+  g_source_destroy (source);
+  g_source_unref (source);
+}
+
+/* called with lock held */
+static SignalDeliverySource *
+get_signal_delivery_source (GDBusConnection *connection,
+                            GMainContext    *context)
+{
+  SignalDeliverySource *delivery_source;
+  GSource *source;
+
+  delivery_source = g_hash_table_lookup (connection->priv->map_context_to_signal_source, context);
+
+  /* the source is destroyed if its context went away; if a context has since
+   * been created at the same address, just attach a new source to it
+   */
+  if (delivery_source != NULL && !g_source_is_destroyed ((GSource *) delivery_source))
+    goto out;
+
+  source = g_source_new (&signal_delivery_source_funcs, sizeof (SignalDeliverySource));
+  delivery_source = (SignalDeliverySource *) source;
+  g_static_mutex_init (&delivery_source->lock);
+  g_queue_init (&delivery_source->pending);
+
+  /* use higher priority that method_reply to ensure signals are handled before method replies */
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_can_recurse (source, TRUE);
+  g_source_attach (source, context);
+
+  /* the hash table owns the reference returned by g_source_new() */
+  g_hash_table_insert (connection->priv->map_context_to_signal_source, context, delivery_source);
+
+ out:
+  return delivery_source;
+}
+
+/* called with lock held; creates *signal_message on the first match */
+static void
+schedule_callbacks (GDBusConnection       *connection,
+                    SignalData            *signal_data,
+                    DBusMessage           *message,
+                    const MessageHeaders  *headers,
+                    SignalMessage        **signal_message)
+{
+  guint n;
+
+  for (n = 0; n < signal_data->subscribers->len; n++)
+    {
+      SignalSubscriber *subscriber;
+      SignalDeliverySource *delivery_source;
+      SignalInstance *signal_instance;
+      gboolean was_empty;
+
+      subscriber = &(g_array_index (signal_data->subscribers, SignalSubscriber, n));
+
+      signal_instance = g_slice_new (SignalInstance);
+      signal_instance->callback = subscriber->callback;
+      signal_instance->user_data = subscriber->user_data;
+      if (*signal_message == NULL)
+        *signal_message = signal_message_new (message, headers);
+      signal_instance->signal_message = signal_message_ref (*signal_message);
+      signal_instance->connection = g_object_ref (connection);
+
+      delivery_source = get_signal_delivery_source (connection, subscriber->context);
+
+      g_static_mutex_lock (&delivery_source->lock);
+      was_empty = g_queue_is_empty (&delivery_source->pending);
+      g_queue_push_tail (&delivery_source->pending, signal_instance);
+      g_static_mutex_unlock (&delivery_source->lock);
+
+      /* only need to wake up the context for the first signal in a batch */
+      if (was_empty)
+        g_main_context_wakeup (g_source_get_context ((GSource *) delivery_source));
+    }
+}
+
+/* must be called with lock held; creates *signal_message on the first match, the caller
+ * should unref it after dropping the lock
+ */
+static void
+distribute_signals_unlocked (GDBusConnection       *connection,
+                             DBusMessage           *message,
+                             const MessageHeaders  *headers,
+                             SignalMessage        **signal_message)
+{
+  SignalData key;
+  SignalData *signal_data;
+  const gchar *arg0;
+  gboolean arg0_needed;
+  guint mask;
+
+  /* Instead of checking every subscription against the message, probe the
+   * index once for every combination of set/wildcard fields that is
+   * actually in use - there are at most SIGNAL_MATCH_NUM_MASKS of those
+   */
+  if (g_hash_table_size (connection->priv->map_match_to_signal_data) == 0)
+    return;
+
+  /* only decode arg0 if someone is matching on it */
+  arg0 = NULL;
+  arg0_needed = FALSE;
+  for (mask = 0; mask < SIGNAL_MATCH_NUM_MASKS; mask++)
+    {
+      if ((mask & SIGNAL_MATCH_ARG0) && connection->priv->signal_data_mask_count[mask] > 0)
+        {
+          arg0_needed = TRUE;
+          break;
+        }
+    }
+  if (arg0_needed)
     {
-      signal_data_array = g_hash_table_lookup (connection->priv->map_sender_to_signal_data_array, sender);
-      if (signal_data_array != NULL) {
-        schedule_callbacks (connection, signal_data_array, message);
-      }
+      if (!dbus_message_get_args (message,
+                                  NULL,
+                                  DBUS_TYPE_STRING, &arg0,
+                                  DBUS_TYPE_INVALID))
+        arg0 = NULL;
     }
 
-  /* collect subcsribers not matching on sender */
-  signal_data_array = g_hash_table_lookup (connection->priv->map_sender_to_signal_data_array, "");
-  if (signal_data_array != NULL) {
-    schedule_callbacks (connection, signal_data_array, message);
-  }
+  for (mask = 0; mask < SIGNAL_MATCH_NUM_MASKS; mask++)
+    {
+      if (connection->priv->signal_data_mask_count[mask] == 0)
+        continue;
+
+      key.sender = NULL;
+      key.object_path = NULL;
+      key.interface_quark = 0;
+      key.member_quark = 0;
+      key.arg0 = NULL;
+
+      if (mask & SIGNAL_MATCH_SENDER)
+        {
+          key.sender = (gchar *) headers->sender;
+          if (key.sender == NULL)
+            continue;
+        }
+      if (mask & SIGNAL_MATCH_OBJECT_PATH)
+        {
+          key.object_path = (gchar *) headers->path;
+          if (key.object_path == NULL)
+            continue;
+        }
+      /* a quark of 0 means no-one subscribed to that name */
+      if (mask & SIGNAL_MATCH_INTERFACE_NAME)
+        {
+          key.interface_quark = headers->interface_quark;
+          if (key.interface_quark == 0)
+            continue;
+        }
+      if (mask & SIGNAL_MATCH_MEMBER)
+        {
+          key.member_quark = headers->member_quark;
+          if (key.member_quark == 0)
+            continue;
+        }
+      if (mask & SIGNAL_MATCH_ARG0)
+        {
+          key.arg0 = (gchar *) arg0;
+          if (key.arg0 == NULL)
+            continue;
+        }
 
-  G_UNLOCK (connection_lock);
+      signal_data = g_hash_table_lookup (connection->priv->map_match_to_signal_data, &key);
+      if (signal_data != NULL)
+        schedule_callbacks (connection, signal_data, message, headers, signal_message);
+    }
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -2214,7 +3081,7 @@ purge_all_signal_subscriptions (GDBusConnection *connection)
   GArray *subscribers;
   guint n;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
   ids = g_array_new (FALSE, FALSE, sizeof (guint));
   g_hash_table_iter_init (&iter, connection->priv->map_id_to_signal_data);
   while (g_hash_table_iter_next (&iter, &key, NULL))
@@ -2233,7 +3100,7 @@ purge_all_signal_subscriptions (GDBusConnection *connection)
     }
   g_array_free (ids, TRUE);
 
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   /* call GDestroyNotify without lock held */
   for (n = 0; n < subscribers->len; n++)
@@ -2256,8 +3123,8 @@ struct ExportedObject
   gchar *object_path;
   GDBusConnection *connection;
 
-  /* maps gchar* -> ExportedInterface* */
-  GHashTable *map_if_name_to_ei;
+  /* maps the GQuark for the interface name -> ExportedInterface* */
+  GHashTable *map_if_quark_to_ei;
 };
 
 /* only called with lock held */
@@ -2271,18 +3138,72 @@ exported_object_free (ExportedObject *eo)
         _g_dbus_oom ();
     }
   g_free (eo->object_path);
-  g_hash_table_unref (eo->map_if_name_to_ei);
+  g_hash_table_unref (eo->map_if_quark_to_ei);
   g_free (eo);
 }
 
+/* Used for interfaces registered with both G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL
+ * and G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER to make sure only one call is handled at a
+ * time. This is refcounted since queued calls may outlive the registration.
+ */
+typedef struct
+{
+  volatile gint ref_count;
+
+  GStaticMutex lock;
+
+  /* whether a call is currently being handled in the thread pool */
+  gboolean running;
+
+  /* GDBusMethodInvocation* waiting for the running call to finish */
+  GQueue pending;
+} MethodCallQueue;
+
+static MethodCallQueue *
+method_call_queue_new (void)
+{
+  MethodCallQueue *queue;
+
+  queue = g_slice_new0 (MethodCallQueue);
+  queue->ref_count = 1;
+  g_static_mutex_init (&queue->lock);
+
+  return queue;
+}
+
+static MethodCallQueue *
+method_call_queue_ref (MethodCallQueue *queue)
+{
+  g_atomic_int_inc (&queue->ref_count);
+  return queue;
+}
+
+static void
+method_call_queue_unref (MethodCallQueue *queue)
+{
+  if (g_atomic_int_dec_and_test (&queue->ref_count))
+    {
+      g_assert (!queue->running);
+      g_assert (g_queue_is_empty (&queue->pending));
+      g_static_mutex_free (&queue->lock);
+      g_slice_free (MethodCallQueue, queue);
+    }
+}
+
 typedef struct
 {
   ExportedObject *eo;
 
   guint                       id;
   gchar                      *interface_name;
+  GQuark                      interface_quark;
   const GDBusInterfaceVTable *vtable;
   const GDBusInterfaceInfo   *introspection_data;
+  GDBusInterfaceInfoIndex    *index;
+  GDBusRegisterObjectFlags    flags;
+
+  /* only set if flags contains G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER */
+  MethodCallQueue            *call_queue;
 
   GMainContext               *context;
   gpointer                    user_data;
@@ -2302,6 +3223,9 @@ exported_interface_free (ExportedInterface *ei)
     {
       g_main_context_unref (ei->context);
     }
+  if (ei->call_queue != NULL)
+    method_call_queue_unref (ei->call_queue);
+  _g_dbus_interface_info_index_free (ei->index);
   g_free (ei->interface_name);
   g_free (ei);
 }
@@ -2474,10 +3398,11 @@ invoke_set_property_in_idle_cb (gpointer _data)
 
 /* can be called with or without the lock held */
 static DBusHandlerResult
-validate_and_maybe_schedule_property_getset (GDBusConnection            *connection,
-                                             DBusMessage                *message,
-                                             const GDBusInterfaceInfo   *introspection_data,
-                                             const GDBusInterfaceVTable *vtable,
+validate_and_maybe_schedule_property_getset (GDBusConnection               *connection,
+                                             DBusMessage                   *message,
+                                             const GDBusInterfaceInfo      *introspection_data,
+                                             const GDBusInterfaceInfoIndex *index,
+                                             const GDBusInterfaceVTable    *vtable,
                                              GMainContext               *main_context,
                                              gpointer                    user_data)
 {
@@ -2518,9 +3443,11 @@ validate_and_maybe_schedule_property_getset (GDBusConnection            *connect
    */
   property_info = NULL;
 
-  /* TODO: the cost of this is O(n) - it might be worth caching the result */
-  property_info = g_dbus_interface_info_lookup_property (introspection_data,
-                                                         property_name);
+  /* exported interfaces have an index; subtrees hand us fresh introspection data */
+  if (index != NULL)
+    property_info = _g_dbus_interface_info_index_lookup_property (index, property_name);
+  else
+    property_info = g_dbus_interface_info_lookup_property (introspection_data, property_name);
   if (property_info == NULL)
     {
       reply = dbus_message_new_error (message,
@@ -2601,7 +3528,7 @@ handle_getset_property (DBusConnection *connection,
   /* Fail with org.freedesktop.DBus.Error.InvalidArgs if there is
    * no such interface registered
    */
-  ei = g_hash_table_lookup (eo->map_if_name_to_ei, interface_name);
+  ei = g_hash_table_lookup (eo->map_if_quark_to_ei, GUINT_TO_POINTER (lookup_name_unlocked (eo->connection, interface_name)));
   if (ei == NULL)
     {
       DBusMessage *reply;
@@ -2617,6 +3544,7 @@ handle_getset_property (DBusConnection *connection,
   ret = validate_and_maybe_schedule_property_getset (eo->connection,
                                                      message,
                                                      ei->introspection_data,
+                                                     ei->index,
                                                      ei->vtable,
                                                      ei->context,
                                                      ei->user_data);
@@ -2782,7 +3710,7 @@ handle_get_all_properties (DBusConnection *connection,
   /* Fail with org.freedesktop.DBus.Error.InvalidArgs if there is
    * no such interface registered
    */
-  ei = g_hash_table_lookup (eo->map_if_name_to_ei, interface_name);
+  ei = g_hash_table_lookup (eo->map_if_quark_to_ei, GUINT_TO_POINTER (lookup_name_unlocked (eo->connection, interface_name)));
   if (ei == NULL)
     {
       DBusMessage *reply;
@@ -2875,7 +3803,7 @@ handle_introspect (DBusConnection *connection,
   introspect_append_standard_interfaces (s);
 
   /* then include the registered interfaces */
-  g_hash_table_iter_init (&hash_iter, eo->map_if_name_to_ei);
+  g_hash_table_iter_init (&hash_iter, eo->map_if_quark_to_ei);
   while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer) &ei))
     {
       g_dbus_interface_info_generate_xml (ei->introspection_data,
@@ -2907,14 +3835,20 @@ handle_introspect (DBusConnection *connection,
   return DBUS_HANDLER_RESULT_HANDLED;
 }
 
-/* called in thread where object was registered - no locks held */
+/* called in thread where object was registered - no locks held
+ *
+ * Used both as an idle callback and, for objects registered with
+ * G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH, directly from the
+ * dispatching thread. For G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL
+ * it is called in a worker thread instead.
+ */
 static gboolean
 invoke_method_in_idle_cb (gpointer user_data)
 {
   GDBusMethodInvocation *invocation = G_DBUS_METHOD_INVOCATION (user_data);
-  GDBusInterfaceVTable *vtable;
+  const GDBusInterfaceVTable *vtable;
 
-  vtable = g_object_get_data (G_OBJECT (invocation), "g-dbus-interface-vtable");
+  vtable = _g_dbus_method_invocation_get_vtable (invocation);
   g_assert (vtable != NULL && vtable->method_call != NULL);
 
   vtable->method_call (g_dbus_method_invocation_get_connection (invocation),
@@ -2928,45 +3862,160 @@ invoke_method_in_idle_cb (gpointer user_data)
   return FALSE;
 }
 
-/* can be called with or without the lock held */
-static DBusHandlerResult
-validate_and_maybe_schedule_method_call (GDBusConnection            *connection,
-                                         DBusMessage                *message,
-                                         const GDBusInterfaceInfo   *introspection_data,
-                                         const GDBusInterfaceVTable *vtable,
-                                         GMainContext               *main_context,
-                                         gpointer                    user_data)
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* the maximum number of threads used for G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL */
+#define METHOD_CALL_POOL_MAX_THREADS 16
+
+typedef struct
 {
   GDBusMethodInvocation *invocation;
-  DBusHandlerResult result;
-  const GDBusMethodInfo *method_info;
-  DBusMessage *reply;
-  GError *error;
-  GVariant *parameters;
-  GSource *idle_source;
 
-  result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  /* NULL unless the call must be handled in order */
+  MethodCallQueue *queue;
+} MethodCallTask;
 
-  /* TODO: the cost of this is O(n) - it might be worth caching the result */
-  method_info = g_dbus_interface_info_lookup_method (introspection_data,
-                                                     dbus_message_get_member (message));
-  /* if the method doesn't exist, return the org.freedesktop.DBus.Error.UnknownMethod
-   * error to the caller */
-  if (method_info == NULL)
+/* called in a worker thread - no locks held */
+static void
+method_call_pool_func (gpointer data,
+                       gpointer user_data)
+{
+  MethodCallTask *task = data;
+  GDBusMethodInvocation *invocation;
+
+  invocation = task->invocation;
+  while (invocation != NULL)
     {
-      reply = dbus_message_new_error (message,
-                                      "org.freedesktop.DBus.Error.UnknownMethod",
-                                      _("No such method"));
-      _g_dbus_connection_send_dbus_1_message (connection, reply);
-      dbus_message_unref (reply);
-      result = DBUS_HANDLER_RESULT_HANDLED;
+      invoke_method_in_idle_cb (invocation);
+      g_object_unref (invocation);
+      invocation = NULL;
+
+      /* for ordered calls, keep handling calls queued up while we were busy */
+      if (task->queue != NULL)
+        {
+          g_static_mutex_lock (&task->queue->lock);
+          invocation = g_queue_pop_head (&task->queue->pending);
+          if (invocation == NULL)
+            task->queue->running = FALSE;
+          g_static_mutex_unlock (&task->queue->lock);
+        }
+    }
+
+  if (task->queue != NULL)
+    method_call_queue_unref (task->queue);
+  g_slice_free (MethodCallTask, task);
+}
+
+static gpointer
+create_method_call_pool (gpointer data)
+{
+  return g_thread_pool_new (method_call_pool_func,
+                            NULL,
+                            METHOD_CALL_POOL_MAX_THREADS,
+                            FALSE,
+                            NULL);
+}
+
+static GThreadPool *
+get_method_call_pool (void)
+{
+  static GOnce once = G_ONCE_INIT;
+  g_once (&once, create_method_call_pool, NULL);
+  return once.retval;
+}
+
+/* takes ownership of @invocation - no locks held */
+static void
+schedule_method_call_in_pool (GDBusMethodInvocation *invocation,
+                              MethodCallQueue       *queue)
+{
+  MethodCallTask *task;
+
+  if (queue != NULL)
+    {
+      g_static_mutex_lock (&queue->lock);
+      if (queue->running)
+        {
+          /* the worker handling the running call will pick this one up */
+          g_queue_push_tail (&queue->pending, invocation);
+          g_static_mutex_unlock (&queue->lock);
+          goto out;
+        }
+      queue->running = TRUE;
+      g_static_mutex_unlock (&queue->lock);
+    }
+
+  task = g_slice_new (MethodCallTask);
+  task->invocation = invocation;
+  task->queue = queue != NULL ? method_call_queue_ref (queue) : NULL;
+  g_thread_pool_push (get_method_call_pool (), task, NULL);
+
+ out:
+  ;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* can be called with or without the lock held
+ *
+ * If @out_invocation is not %NULL, the invocation is returned there
+ * instead of being scheduled in idle in @main_context; the caller must
+ * then pass it to invoke_method_in_idle_cb() once the lock has been
+ * released and drop the reference afterwards.
+ */
+static DBusHandlerResult
+validate_and_maybe_schedule_method_call (GDBusConnection               *connection,
+                                         DBusMessage                   *message,
+                                         const MessageHeaders          *headers,
+                                         const GDBusInterfaceInfo      *introspection_data,
+                                         const GDBusInterfaceInfoIndex *index,
+                                         const GDBusInterfaceVTable    *vtable,
+                                         GMainContext               *main_context,
+                                         gpointer                    user_data,
+                                         GDBusMethodInvocation     **out_invocation)
+{
+  GDBusMethodInvocation *invocation;
+  DBusHandlerResult result;
+  const GDBusMethodInfo *method_info;
+  GVariantTypeInfo *in_type_info;
+  GVariantTypeInfo *out_type_info;
+  DBusMessage *reply;
+  GError *error;
+  GVariant *parameters;
+  GSource *idle_source;
+
+  result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  /* exported interfaces have an index; subtrees hand us fresh introspection data */
+  if (index != NULL)
+    method_info = _g_dbus_interface_info_index_lookup_method (index, headers->member);
+  else
+    method_info = g_dbus_interface_info_lookup_method (introspection_data, headers->member);
+  /* if the method doesn't exist, return the org.freedesktop.DBus.Error.UnknownMethod
+   * error to the caller */
+  if (method_info == NULL)
+    {
+      reply = dbus_message_new_error (message,
+                                      "org.freedesktop.DBus.Error.UnknownMethod",
+                                      _("No such method"));
+      _g_dbus_connection_send_dbus_1_message (connection, reply);
+      dbus_message_unref (reply);
+      result = DBUS_HANDLER_RESULT_HANDLED;
       goto out;
     }
 
+  in_type_info = NULL;
+  out_type_info = NULL;
+  if (index != NULL)
+    _g_dbus_interface_info_index_get_method_types (index, method_info, &in_type_info, &out_type_info);
+
   /* Check that the incoming args are of the right type - if they are not, return
-   * the org.freedesktop.DBus.Error.InvalidArgs error to the caller
+   * the org.freedesktop.DBus.Error.InvalidArgs error to the caller. This is done
+   * on the signature, before converting the body, so bad calls are cheap to reject.
    */
-  if (!dbus_message_has_signature (message, method_info->in_signature))
+  if (!_g_dbus_method_info_check_in_signature (method_info,
+                                               in_type_info,
+                                               dbus_message_get_signature (message)))
     {
       reply = dbus_message_new_error (message,
                                       "org.freedesktop.DBus.Error.InvalidArgs",
@@ -2987,24 +4036,21 @@ validate_and_maybe_schedule_method_call (GDBusConnection            *connection,
     }
 
   /* schedule the call in idle */
-  invocation = g_dbus_method_invocation_new (dbus_message_get_sender (message),
-                                             dbus_message_get_path (message),
-                                             dbus_message_get_interface (message),
-                                             dbus_message_get_member (message),
-                                             connection,
-                                             parameters,
-                                             user_data);
+  invocation = _g_dbus_method_invocation_new (message,
+                                              connection,
+                                              parameters,
+                                              vtable,
+                                              method_info,
+                                              out_type_info,
+                                              user_data);
   g_variant_unref (parameters);
-  g_object_set_data_full (G_OBJECT (invocation),
-                          "dbus-1-message",
-                          dbus_message_ref (message),
-                          (GDestroyNotify) dbus_message_unref);
-  g_object_set_data (G_OBJECT (invocation),
-                     "g-dbus-interface-vtable",
-                     (gpointer) vtable);
-  g_object_set_data (G_OBJECT (invocation),
-                     "g-dbus-method-info",
-                     (gpointer) method_info);
+
+  if (out_invocation != NULL)
+    {
+      *out_invocation = invocation;
+      result = DBUS_HANDLER_RESULT_HANDLED;
+      goto out;
+    }
 
   idle_source = g_idle_source_new ();
   g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
@@ -3028,67 +4074,94 @@ dbus_1_obj_vtable_message_func (DBusConnection *connection,
                                 void           *user_data)
 {
   ExportedObject *eo = user_data;
-  const char *interface_name;
+  const MessageHeaders *headers;
   DBusHandlerResult result;
+  GDBusMethodInvocation *invocation;
+  MethodCallQueue *call_queue;
+  gboolean use_thread_pool;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (eo->connection);
 
   result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  invocation = NULL;
+  call_queue = NULL;
+  use_thread_pool = FALSE;
 
   //g_debug ("in dbus_1_obj_vtable_message_func for path %s", eo->object_path);
   //PRINT_MESSAGE (message);
 
+  headers = message_headers_get (eo->connection, message);
+
   /* see if we have an interface for this handling this call */
-  interface_name = dbus_message_get_interface (message);
-  if (interface_name != NULL)
+  if (headers->interface_quark != 0)
     {
       ExportedInterface *ei;
-      ei = g_hash_table_lookup (eo->map_if_name_to_ei, interface_name);
+      ei = g_hash_table_lookup (eo->map_if_quark_to_ei, GUINT_TO_POINTER (headers->interface_quark));
       if (ei != NULL)
         {
-          /* we do - invoke the handler in idle in the right thread */
+          gboolean dispatch_directly;
+
+          /* we do - invoke the handler in idle in the right thread - or, if
+           * the user asked for it, in the thread pool or right away if we're
+           * already in the right thread
+           */
 
           /* handle no vtable or handler being present */
           if (ei->vtable == NULL || ei->vtable->method_call == NULL)
             goto out;
 
+          dispatch_directly = FALSE;
+          if (ei->flags & G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL)
+            {
+              use_thread_pool = TRUE;
+              if (ei->call_queue != NULL)
+                call_queue = method_call_queue_ref (ei->call_queue);
+            }
+          else if (ei->flags & G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH)
+            {
+              dispatch_directly = g_main_context_is_owner (ei->context != NULL ? ei->context : g_main_context_default ());
+            }
+
           result = validate_and_maybe_schedule_method_call (eo->connection,
                                                             message,
+                                                            headers,
                                                             ei->introspection_data,
+                                                            ei->index,
                                                             ei->vtable,
                                                             ei->context,
-                                                            ei->user_data);
+                                                            ei->user_data,
+                                                            (use_thread_pool || dispatch_directly) ? &invocation : NULL);
           goto out;
         }
     }
 
-  if (dbus_message_is_method_call (message,
-                                   "org.freedesktop.DBus.Introspectable",
-                                   "Introspect") &&
+  if (message_headers_is_method_call (headers,
+                                      quark_interface_introspectable,
+                                      quark_member_introspect) &&
       g_strcmp0 (dbus_message_get_signature (message), "") == 0)
     {
       result = handle_introspect (connection, eo, message);
       goto out;
     }
-  else if (dbus_message_is_method_call (message,
-                                        "org.freedesktop.DBus.Properties",
-                                        "Get") &&
+  else if (message_headers_is_method_call (headers,
+                                           quark_interface_properties,
+                                           quark_member_get) &&
            g_strcmp0 (dbus_message_get_signature (message), "ss") == 0)
     {
       result = handle_getset_property (connection, eo, message);
       goto out;
     }
-  else if (dbus_message_is_method_call (message,
-                                        "org.freedesktop.DBus.Properties",
-                                        "Set") &&
+  else if (message_headers_is_method_call (headers,
+                                           quark_interface_properties,
+                                           quark_member_set) &&
            g_strcmp0 (dbus_message_get_signature (message), "ssv") == 0)
     {
       result = handle_getset_property (connection, eo, message);
       goto out;
     }
-  else if (dbus_message_is_method_call (message,
-                                        "org.freedesktop.DBus.Properties",
-                                        "GetAll") &&
+  else if (message_headers_is_method_call (headers,
+                                           quark_interface_properties,
+                                           quark_member_get_all) &&
            g_strcmp0 (dbus_message_get_signature (message), "s") == 0)
     {
       result = handle_get_all_properties (connection, eo, message);
@@ -3096,7 +4169,23 @@ dbus_1_obj_vtable_message_func (DBusConnection *connection,
     }
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (eo->connection);
+
+  if (invocation != NULL)
+    {
+      if (use_thread_pool)
+        {
+          schedule_method_call_in_pool (invocation, call_queue);
+        }
+      else
+        {
+          invoke_method_in_idle_cb (invocation);
+          g_object_unref (invocation);
+        }
+    }
+  if (call_queue != NULL)
+    method_call_queue_unref (call_queue);
+
   return result;
 }
 
@@ -3117,6 +4206,7 @@ static const DBusObjectPathVTable dbus_1_obj_vtable =
  * @interface_name: The D-Bus interface to register.
  * @introspection_data: Introspection data for the interface.
  * @vtable: A #GDBusInterfaceVTable to call into or %NULL.
+ * @flags: Flags from the #GDBusRegisterObjectFlags enumeration.
  * @user_data: Data to pass to functions in @vtable.
  * @user_data_free_func: Function to call when the object path is unregistered.
  * @error: Return location for error or %NULL.
@@ -3128,6 +4218,20 @@ static const DBusObjectPathVTable dbus_1_obj_vtable =
  * happen in the <link linkend="g-main-context-push-thread-default">thread-default main
  * loop</link> of the thread you are calling this method from.
  *
+ * Method calls are normally delivered from an idle source in that main
+ * loop. If @flags contains %G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH
+ * and the message is received in a thread that owns the main loop, the
+ * method_call() function in @vtable is invoked right away instead.
+ *
+ * If @flags contains %G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL,
+ * the method_call() function is instead invoked in a worker thread from
+ * a bounded pool shared by all connections and method calls may be
+ * handled concurrently. Add %G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER
+ * to have calls for the interface handled one at a time in the order
+ * they were received. Other functions in @vtable are still called in the
+ * thread-default main loop. This requires g_thread_init() to have been
+ * called.
+ *
  * Note that all #GVariant values passed to functions in @vtable will match
  * the signature given in @introspection_data - if a remote caller passes
  * incorrect values, the <literal>org.freedesktop.DBus.Error.InvalidArgs</literal>
@@ -3155,6 +4259,7 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
                                    const gchar                *interface_name,
                                    const GDBusInterfaceInfo   *introspection_data,
                                    const GDBusInterfaceVTable *vtable,
+                                   GDBusRegisterObjectFlags    flags,
                                    gpointer                    user_data,
                                    GDestroyNotify              user_data_free_func,
                                    GError                    **error)
@@ -3171,7 +4276,7 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
 
   ret = 0;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   eo = g_hash_table_lookup (connection->priv->map_object_path_to_eo, object_path);
   if (eo == NULL)
@@ -3181,10 +4286,10 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
       eo = g_new0 (ExportedObject, 1);
       eo->object_path = g_strdup (object_path);
       eo->connection = connection;
-      eo->map_if_name_to_ei = g_hash_table_new_full (g_str_hash,
-                                                     g_str_equal,
-                                                     NULL,
-                                                     (GDestroyNotify) exported_interface_free);
+      eo->map_if_quark_to_ei = g_hash_table_new_full (g_direct_hash,
+                                                      g_direct_equal,
+                                                      NULL,
+                                                      (GDestroyNotify) exported_interface_free);
       g_hash_table_insert (connection->priv->map_object_path_to_eo, eo->object_path, eo);
 
       dbus_error_init (&dbus_error);
@@ -3212,7 +4317,7 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
         }
     }
 
-  ei = g_hash_table_lookup (eo->map_if_name_to_ei, interface_name);
+  ei = g_hash_table_lookup (eo->map_if_quark_to_ei, GUINT_TO_POINTER (lookup_name_unlocked (connection, interface_name)));
   if (ei != NULL)
     {
       g_set_error (error,
@@ -3225,19 +4330,25 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
     }
 
   ei = g_new0 (ExportedInterface, 1);
-  ei->id = _global_registration_id++; /* TODO: overflow etc. */
+  ei->id = g_atomic_int_exchange_and_add (&_global_registration_id, 1); /* TODO: overflow etc. */
   ei->eo = eo;
   ei->user_data = user_data;
   ei->user_data_free_func = user_data_free_func;
   ei->vtable = vtable;
+  ei->flags = flags;
+  if ((flags & G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL) &&
+      (flags & G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER))
+    ei->call_queue = method_call_queue_new ();
   ei->introspection_data = introspection_data;
+  ei->index = _g_dbus_interface_info_index_new (ei->introspection_data);
   ei->interface_name = g_strdup (interface_name);
+  ei->interface_quark = intern_name_unlocked (connection, interface_name);
   ei->context = g_main_context_get_thread_default ();
   if (ei->context != NULL)
     g_main_context_ref (ei->context);
 
-  g_hash_table_insert (eo->map_if_name_to_ei,
-                       (gpointer) ei->interface_name,
+  g_hash_table_insert (eo->map_if_quark_to_ei,
+                       GUINT_TO_POINTER (ei->interface_quark),
                        ei);
   g_hash_table_insert (connection->priv->map_id_to_ei,
                        GUINT_TO_POINTER (ei->id),
@@ -3246,7 +4357,7 @@ g_dbus_connection_register_object (GDBusConnection            *connection,
   ret = ei->id;
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   return ret;
 }
@@ -3272,7 +4383,7 @@ g_dbus_connection_unregister_object (GDBusConnection *connection,
 
   ret = FALSE;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   ei = g_hash_table_lookup (connection->priv->map_id_to_ei,
                             GUINT_TO_POINTER (registration_id));
@@ -3284,9 +4395,9 @@ g_dbus_connection_unregister_object (GDBusConnection *connection,
   eo = ei->eo;
 
   g_assert (g_hash_table_remove (connection->priv->map_id_to_ei, GUINT_TO_POINTER (ei->id)));
-  g_assert (g_hash_table_remove (eo->map_if_name_to_ei, ei->interface_name));
+  g_assert (g_hash_table_remove (eo->map_if_quark_to_ei, GUINT_TO_POINTER (ei->interface_quark)));
   /* unregister object path if we have no more exported interfaces */
-  if (g_hash_table_size (eo->map_if_name_to_ei) == 0)
+  if (g_hash_table_size (eo->map_if_quark_to_ei) == 0)
     {
       g_assert (g_hash_table_remove (connection->priv->map_object_path_to_eo,
                                      eo->object_path));
@@ -3295,7 +4406,7 @@ g_dbus_connection_unregister_object (GDBusConnection *connection,
   ret = TRUE;
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   return ret;
 }
@@ -3369,6 +4480,122 @@ g_dbus_connection_emit_signal (GDBusConnection    *connection,
   return ret;
 }
 
+/**
+ * g_dbus_connection_emit_signal_multi:
+ * @connection: A #GDBusConnection.
+ * @destination_bus_names: A %NULL-terminated array of unique bus names to send the signal to or %NULL to emit to all listeners.
+ * @object_paths: A %NULL-terminated array of object paths to emit the signal from. Must contain at least one path.
+ * @interface_name: D-Bus interface to emit a signal on.
+ * @signal_name: The name of the signal to emit.
+ * @parameters: A #GVariant tuple with parameters for the signal or %NULL if not passing parameters.
+ * @error: Return location for error or %NULL.
+ *
+ * Like g_dbus_connection_emit_signal() but emits the signal once for
+ * each combination of destination in @destination_bus_names and
+ * object path in @object_paths.
+ *
+ * @parameters is only converted to the D-Bus wire format once and the
+ * resulting body is shared by all the emitted messages, so this is
+ * considerably cheaper than calling g_dbus_connection_emit_signal()
+ * in a loop.
+ *
+ * This can only fail if @parameters is not compatible with the D-Bus
+ * protocol, in which case no signal is emitted.
+ *
+ * Returns: %TRUE unless @error is set.
+ */
+gboolean
+g_dbus_connection_emit_signal_multi (GDBusConnection    *connection,
+                                     const gchar *const *destination_bus_names,
+                                     const gchar *const *object_paths,
+                                     const gchar        *interface_name,
+                                     const gchar        *signal_name,
+                                     GVariant           *parameters,
+                                     GError            **error)
+{
+  DBusMessage *template;
+  gboolean ret;
+  guint num_destinations;
+  guint n;
+  guint m;
+
+  template = NULL;
+  ret = FALSE;
+
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+  g_return_val_if_fail (object_paths != NULL && object_paths[0] != NULL, FALSE);
+  g_return_val_if_fail (interface_name != NULL, FALSE);
+  g_return_val_if_fail (signal_name != NULL, FALSE);
+  g_return_val_if_fail ((parameters == NULL) || (g_variant_get_type_class (parameters) == G_VARIANT_CLASS_TUPLE), FALSE);
+
+  /* serialize the body once ... */
+  template = dbus_message_new_signal (object_paths[0],
+                                      interface_name,
+                                      signal_name);
+  if (template == NULL)
+    _g_dbus_oom ();
+
+  if (!_g_dbus_gvariant_to_dbus_1 (template,
+                                   parameters,
+                                   error))
+    {
+      goto out;
+    }
+
+  num_destinations = 1;
+  if (destination_bus_names != NULL)
+    num_destinations = g_strv_length ((gchar **) destination_bus_names);
+
+  /* ... and only patch up the header for each message; the lock is
+   * held across the whole loop so the messages go out back-to-back
+   */
+  CONNECTION_LOCK (connection);
+  if (connection->priv->dbus_1_connection == NULL)
+    {
+      CONNECTION_UNLOCK (connection);
+      ret = TRUE;
+      goto out;
+    }
+  for (n = 0; n < num_destinations; n++)
+    {
+      for (m = 0; object_paths[m] != NULL; m++)
+        {
+          DBusMessage *message;
+
+          message = dbus_message_copy (template);
+          if (message == NULL)
+            _g_dbus_oom ();
+
+          if (m > 0)
+            {
+              if (!dbus_message_set_path (message, object_paths[m]))
+                _g_dbus_oom ();
+            }
+
+          if (destination_bus_names != NULL)
+            {
+              if (!dbus_message_set_destination (message, destination_bus_names[n]))
+                _g_dbus_oom ();
+            }
+
+          if (!dbus_connection_send (connection->priv->dbus_1_connection,
+                                     message,
+                                     NULL))
+            _g_dbus_oom ();
+          dbus_message_unref (message);
+        }
+    }
+  CONNECTION_UNLOCK (connection);
+
+  ret = TRUE;
+
+ out:
+  if (template != NULL)
+    dbus_message_unref (template);
+
+  return ret;
+}
+
 /**
  * g_dbus_connection_invoke_method:
  * @connection: A #GDBusConnection.
@@ -3387,6 +4614,11 @@ g_dbus_connection_emit_signal (GDBusConnection    *connection,
  * @interface_name D-Bus interface on the remote object at
  * @object_path owned by @bus_name.
  *
+ * If @callback is %NULL, the message is sent with the
+ * <literal>NO_REPLY_EXPECTED</literal> flag set and nothing is
+ * tracked locally; the remote side is then free to not send a
+ * reply at all.
+ *
  * If @connection is disconnected then the operation will fail with
  * %G_DBUS_ERROR_DISCONNECTED. If @cancellable is canceled, the
  * operation will fail with %G_DBUS_ERROR_CANCELLED. If @parameters
@@ -3435,6 +4667,7 @@ g_dbus_connection_invoke_method (GDBusConnection    *connection,
 
   if (callback == NULL)
     {
+      dbus_message_set_no_reply (message, TRUE);
       if (_g_dbus_gvariant_to_dbus_1 (message,
                                       parameters,
                                       &error))
@@ -3614,6 +4847,547 @@ g_dbus_connection_invoke_method_sync (GDBusConnection    *connection,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+typedef struct
+{
+  GDBusMethodCallBatch *batch;
+
+  /* the serialized call; freed once it has been handed to libdbus */
+  DBusMessage          *message;
+
+  /* protected by batch->lock */
+  DBusPendingCall      *pending_call;
+  DBusMessage          *reply;
+  GError               *error;
+  gboolean              done;
+} BatchedCall;
+
+/**
+ * GDBusMethodCallBatch:
+ *
+ * The #GDBusMethodCallBatch structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _GDBusMethodCallBatch
+{
+  volatile gint       ref_count;
+
+  /* array of BatchedCall* - fixed once the batch has been submitted */
+  GPtrArray          *calls;
+  gboolean            submitted;
+
+  /* the thread-default context at submission time - fixed once the batch has been submitted */
+  GMainContext       *context;
+
+  /* protects everything below as well as the mutable parts of BatchedCall */
+  GStaticMutex        lock;
+  guint               num_outstanding;
+  gboolean            completed;
+  GSimpleAsyncResult *simple;
+  GCancellable       *cancellable;
+  gulong              cancellable_handler_id;
+};
+
+static void
+batched_call_free (BatchedCall *call)
+{
+  if (call->message != NULL)
+    dbus_message_unref (call->message);
+  if (call->pending_call != NULL)
+    dbus_pending_call_unref (call->pending_call);
+  if (call->reply != NULL)
+    dbus_message_unref (call->reply);
+  if (call->error != NULL)
+    g_error_free (call->error);
+  g_free (call);
+}
+
+/**
+ * g_dbus_method_call_batch_new:
+ *
+ * Creates a new, empty, batch of method calls. Add calls with
+ * g_dbus_method_call_batch_add() and send them all at once with
+ * g_dbus_connection_invoke_method_batch().
+ *
+ * Returns: A #GDBusMethodCallBatch. Free with g_dbus_method_call_batch_unref().
+ */
+GDBusMethodCallBatch *
+g_dbus_method_call_batch_new (void)
+{
+  GDBusMethodCallBatch *batch;
+
+  batch = g_new0 (GDBusMethodCallBatch, 1);
+  batch->ref_count = 1;
+  batch->calls = g_ptr_array_new ();
+  g_static_mutex_init (&batch->lock);
+
+  return batch;
+}
+
+/**
+ * g_dbus_method_call_batch_ref:
+ * @batch: A #GDBusMethodCallBatch.
+ *
+ * Increases the reference count on @batch.
+ *
+ * Returns: @batch.
+ */
+GDBusMethodCallBatch *
+g_dbus_method_call_batch_ref (GDBusMethodCallBatch *batch)
+{
+  g_return_val_if_fail (batch != NULL, NULL);
+
+  g_atomic_int_inc (&batch->ref_count);
+
+  return batch;
+}
+
+/**
+ * g_dbus_method_call_batch_unref:
+ * @batch: A #GDBusMethodCallBatch.
+ *
+ * Decreases the reference count on @batch. If the reference count
+ * drops to zero, all resources used by @batch, including any results,
+ * are freed.
+ */
+void
+g_dbus_method_call_batch_unref (GDBusMethodCallBatch *batch)
+{
+  g_return_if_fail (batch != NULL);
+
+  if (g_atomic_int_dec_and_test (&batch->ref_count))
+    {
+      g_ptr_array_foreach (batch->calls, (GFunc) batched_call_free, NULL);
+      g_ptr_array_free (batch->calls, TRUE);
+      if (batch->context != NULL)
+        g_main_context_unref (batch->context);
+      g_static_mutex_free (&batch->lock);
+      g_free (batch);
+    }
+}
+
+/**
+ * g_dbus_method_call_batch_add:
+ * @batch: A #GDBusMethodCallBatch that has not yet been submitted.
+ * @bus_name: A unique or well-known bus name or %NULL if the batch will be sent on a peer-to-peer connection.
+ * @object_path: Path of remote object.
+ * @interface_name: D-Bus interface to invoke method on.
+ * @method_name: The name of the method to invoke.
+ * @parameters: A #GVariant tuple with parameters for the method or %NULL if not passing parameters.
+ *
+ * Adds a method call to @batch. The call is serialized right away; if
+ * @parameters contains a value not compatible with the D-Bus protocol,
+ * the call is not sent and g_dbus_method_call_batch_get_result() will
+ * report %G_DBUS_ERROR_CONVERSION_FAILED for it.
+ *
+ * Returns: The index of the call in @batch, to be passed to g_dbus_method_call_batch_get_result().
+ */
+guint
+g_dbus_method_call_batch_add (GDBusMethodCallBatch *batch,
+                              const gchar          *bus_name,
+                              const gchar          *object_path,
+                              const gchar          *interface_name,
+                              const gchar          *method_name,
+                              GVariant             *parameters)
+{
+  BatchedCall *call;
+
+  g_return_val_if_fail (batch != NULL, 0);
+  g_return_val_if_fail (!batch->submitted, 0);
+  g_return_val_if_fail (object_path != NULL, 0);
+  g_return_val_if_fail (interface_name != NULL, 0);
+  g_return_val_if_fail (method_name != NULL, 0);
+  g_return_val_if_fail ((parameters == NULL) || (g_variant_get_type_class (parameters) == G_VARIANT_CLASS_TUPLE), 0);
+
+  call = g_new0 (BatchedCall, 1);
+  call->batch = batch;
+  call->message = dbus_message_new_method_call (bus_name,
+                                                object_path,
+                                                interface_name,
+                                                method_name);
+  if (call->message == NULL)
+    _g_dbus_oom ();
+
+  if (!_g_dbus_gvariant_to_dbus_1 (call->message,
+                                   parameters,
+                                   &call->error))
+    {
+      dbus_message_unref (call->message);
+      call->message = NULL;
+      call->done = TRUE;
+    }
+
+  g_ptr_array_add (batch->calls, call);
+
+  return batch->calls->len - 1;
+}
+
+/**
+ * g_dbus_method_call_batch_get_n_calls:
+ * @batch: A #GDBusMethodCallBatch.
+ *
+ * Gets the number of method calls in @batch.
+ *
+ * Returns: The number of calls added with g_dbus_method_call_batch_add().
+ */
+guint
+g_dbus_method_call_batch_get_n_calls (GDBusMethodCallBatch *batch)
+{
+  g_return_val_if_fail (batch != NULL, 0);
+
+  return batch->calls->len;
+}
+
+/**
+ * g_dbus_method_call_batch_get_result:
+ * @batch: A #GDBusMethodCallBatch that has completed.
+ * @index: The index returned by g_dbus_method_call_batch_add().
+ * @error: Return location for error or %NULL.
+ *
+ * Gets the result of the method call at @index in @batch. This can
+ * only be used once the operation started with
+ * g_dbus_connection_invoke_method_batch() has completed.
+ *
+ * Returns: %NULL if @error is set. Otherwise a #GVariant tuple with
+ * return values. Free with g_variant_unref().
+ */
+GVariant *
+g_dbus_method_call_batch_get_result (GDBusMethodCallBatch  *batch,
+                                     guint                  index,
+                                     GError               **error)
+{
+  BatchedCall *call;
+  GVariant *result;
+  gboolean completed;
+
+  g_return_val_if_fail (batch != NULL, NULL);
+  g_return_val_if_fail (index < batch->calls->len, NULL);
+
+  /* completed is set from whatever thread the last reply arrives in */
+  g_static_mutex_lock (&batch->lock);
+  completed = batch->completed;
+  g_static_mutex_unlock (&batch->lock);
+  g_return_val_if_fail (completed, NULL);
+
+  result = NULL;
+
+  g_static_mutex_lock (&batch->lock);
+
+  call = batch->calls->pdata[index];
+  if (call->error != NULL)
+    {
+      if (error != NULL)
+        *error = g_error_copy (call->error);
+      goto out;
+    }
+
+  g_assert (call->reply != NULL);
+  result = _g_dbus_dbus_1_to_gvariant (call->reply, error);
+
+ out:
+  g_static_mutex_unlock (&batch->lock);
+  return result;
+}
+
+/* called when the last outstanding call in @batch is done; must not hold batch->lock */
+static void
+method_call_batch_complete (GDBusMethodCallBatch *batch)
+{
+  GSimpleAsyncResult *simple;
+  GCancellable *cancellable;
+  gulong cancellable_handler_id;
+
+  g_static_mutex_lock (&batch->lock);
+  g_assert (batch->num_outstanding == 0);
+  batch->completed = TRUE;
+  simple = batch->simple;
+  cancellable = batch->cancellable;
+  cancellable_handler_id = batch->cancellable_handler_id;
+  batch->simple = NULL;
+  batch->cancellable = NULL;
+  batch->cancellable_handler_id = 0;
+  g_static_mutex_unlock (&batch->lock);
+
+  if (cancellable != NULL)
+    {
+      if (cancellable_handler_id > 0)
+        g_cancellable_disconnect (cancellable, cancellable_handler_id);
+      g_object_unref (cancellable);
+    }
+
+  g_simple_async_result_complete_in_idle (simple);
+  g_object_unref (simple);
+}
+
+static void
+batched_call_reply_cb (DBusPendingCall *pending_call,
+                       void            *user_data)
+{
+  BatchedCall *call = user_data;
+  GDBusMethodCallBatch *batch = call->batch;
+  gboolean last;
+
+  last = FALSE;
+
+  g_static_mutex_lock (&batch->lock);
+  /* the call may have been cancelled in the meantime */
+  if (!call->done)
+    {
+      call->reply = dbus_pending_call_steal_reply (pending_call);
+      g_assert (call->reply != NULL);
+      call->done = TRUE;
+      last = (--batch->num_outstanding == 0);
+    }
+  g_static_mutex_unlock (&batch->lock);
+
+  if (last)
+    method_call_batch_complete (batch);
+}
+
+static gboolean
+method_call_batch_cancelled_in_idle (gpointer user_data)
+{
+  GDBusMethodCallBatch *batch = user_data;
+  gboolean last;
+  guint n;
+
+  last = FALSE;
+
+  g_static_mutex_lock (&batch->lock);
+  for (n = 0; n < batch->calls->len && batch->num_outstanding > 0; n++)
+    {
+      BatchedCall *call = batch->calls->pdata[n];
+
+      if (call->done)
+        continue;
+
+      dbus_pending_call_cancel (call->pending_call);
+      g_set_error (&call->error,
+                   G_DBUS_ERROR,
+                   G_DBUS_ERROR_CANCELLED,
+                   _("Operation was cancelled"));
+      call->done = TRUE;
+      last = (--batch->num_outstanding == 0);
+    }
+  g_static_mutex_unlock (&batch->lock);
+
+  if (last)
+    method_call_batch_complete (batch);
+
+  return FALSE;
+}
+
+static void
+method_call_batch_cancelled_cb (GCancellable *cancellable,
+                                gpointer      user_data)
+{
+  GDBusMethodCallBatch *batch = user_data;
+  GSource *idle_source;
+
+  /* can't disconnect from the cancellable while it is being emitted so defer to idle - in
+   * the context the batch was submitted from since the cancellable may be cancelled anywhere
+   */
+  idle_source = g_idle_source_new ();
+  g_source_set_priority (idle_source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_set_callback (idle_source,
+                         method_call_batch_cancelled_in_idle,
+                         g_dbus_method_call_batch_ref (batch),
+                         (GDestroyNotify) g_dbus_method_call_batch_unref);
+  g_source_attach (idle_source, batch->context);
+  g_source_unref (idle_source);
+}
+
+/**
+ * g_dbus_connection_invoke_method_batch:
+ * @connection: A #GDBusConnection.
+ * @batch: A #GDBusMethodCallBatch that has not yet been submitted.
+ * @timeout_msec: The timeout in milliseconds for each call or -1 to use the default timeout.
+ * @cancellable: A #GCancellable or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when all calls in @batch have completed.
+ * @user_data: The data to pass to @callback.
+ *
+ * Asynchronously invokes all the method calls in @batch. This is
+ * equivalent to calling g_dbus_connection_invoke_method() for each
+ * call, but all calls are handed to the transport in one go and share
+ * a single completion and cancellation hookup. This is useful e.g. for
+ * fetching the state of a large number of objects at start-up.
+ *
+ * When replies (or errors) have been received for all calls, @callback
+ * will be invoked in the <link
+ * linkend="g-main-context-push-thread-default">thread-default main
+ * loop</link> of the thread you are calling this method from. You can
+ * then call g_dbus_connection_invoke_method_batch_finish() followed by
+ * g_dbus_method_call_batch_get_result() for each call. If @cancellable
+ * is canceled, calls that have not yet completed fail with
+ * %G_DBUS_ERROR_CANCELLED.
+ *
+ * A batch can only be submitted once.
+ */
+void
+g_dbus_connection_invoke_method_batch (GDBusConnection      *connection,
+                                       GDBusMethodCallBatch *batch,
+                                       gint                  timeout_msec,
+                                       GCancellable         *cancellable,
+                                       GAsyncReadyCallback   callback,
+                                       gpointer              user_data)
+{
+  GSimpleAsyncResult *simple;
+  guint n;
+
+  g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+  g_return_if_fail (batch != NULL);
+  g_return_if_fail (!batch->submitted);
+  g_return_if_fail (callback != NULL);
+
+  batch->submitted = TRUE;
+  batch->context = g_main_context_get_thread_default ();
+  if (batch->context != NULL)
+    g_main_context_ref (batch->context);
+
+  simple = g_simple_async_result_new (G_OBJECT (connection),
+                                      callback,
+                                      user_data,
+                                      g_dbus_connection_invoke_method_batch);
+
+  /* don't even send anything if already cancelled */
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      g_simple_async_result_set_error (simple,
+                                       G_DBUS_ERROR,
+                                       G_DBUS_ERROR_CANCELLED,
+                                       _("Operation was cancelled"));
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+      goto out;
+    }
+
+  CONNECTION_LOCK (connection);
+
+  if (connection->priv->dbus_1_connection == NULL)
+    {
+      CONNECTION_UNLOCK (connection);
+      g_simple_async_result_set_error (simple,
+                                       G_DBUS_ERROR,
+                                       G_DBUS_ERROR_DISCONNECTED,
+                                       _("Not connected"));
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+      goto out;
+    }
+
+  g_simple_async_result_set_op_res_gpointer (simple,
+                                             g_dbus_method_call_batch_ref (batch),
+                                             (GDestroyNotify) g_dbus_method_call_batch_unref);
+
+  g_static_mutex_lock (&batch->lock);
+
+  batch->simple = simple;
+  /* hold an extra count until the cancellable is hooked up so we can't complete before that */
+  batch->num_outstanding = 1;
+
+  for (n = 0; n < batch->calls->len; n++)
+    {
+      BatchedCall *call = batch->calls->pdata[n];
+
+      if (call->done)
+        continue;
+
+      if (!dbus_connection_send_with_reply (connection->priv->dbus_1_connection,
+                                            call->message,
+                                            &call->pending_call,
+                                            timeout_msec))
+        _g_dbus_oom ();
+
+      dbus_message_unref (call->message);
+      call->message = NULL;
+
+      if (call->pending_call == NULL)
+        {
+          g_set_error (&call->error,
+                       G_DBUS_ERROR,
+                       G_DBUS_ERROR_DISCONNECTED,
+                       _("Not connected"));
+          call->done = TRUE;
+          continue;
+        }
+
+      dbus_pending_call_set_notify (call->pending_call,
+                                    batched_call_reply_cb,
+                                    call,
+                                    NULL);
+
+      /* the reply may have arrived (e.g. on the I/O worker thread) before the notify was set */
+      if (dbus_pending_call_get_completed (call->pending_call))
+        {
+          call->reply = dbus_pending_call_steal_reply (call->pending_call);
+          call->done = TRUE;
+          continue;
+        }
+
+      batch->num_outstanding++;
+    }
+
+  g_static_mutex_unlock (&batch->lock);
+
+  CONNECTION_UNLOCK (connection);
+
+  if (cancellable != NULL)
+    {
+      gulong cancellable_handler_id;
+
+      cancellable_handler_id = g_cancellable_connect (cancellable,
+                                                      G_CALLBACK (method_call_batch_cancelled_cb),
+                                                      batch,
+                                                      NULL);
+      g_static_mutex_lock (&batch->lock);
+      batch->cancellable = g_object_ref (cancellable);
+      batch->cancellable_handler_id = cancellable_handler_id;
+      g_static_mutex_unlock (&batch->lock);
+    }
+
+  /* drop the extra count */
+  g_static_mutex_lock (&batch->lock);
+  n = --batch->num_outstanding;
+  g_static_mutex_unlock (&batch->lock);
+  if (n == 0)
+    method_call_batch_complete (batch);
+
+ out:
+  ;
+}
+
+/**
+ * g_dbus_connection_invoke_method_batch_finish:
+ * @connection: A #GDBusConnection.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to g_dbus_connection_invoke_method_batch().
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with g_dbus_connection_invoke_method_batch().
+ *
+ * This only fails if none of the calls could be sent, e.g. because
+ * @connection is disconnected. Use
+ * g_dbus_method_call_batch_get_result() to get the outcome of each
+ * individual call.
+ *
+ * Returns: %TRUE if the batch was sent, %FALSE if @error is set.
+ */
+gboolean
+g_dbus_connection_invoke_method_batch_finish (GDBusConnection  *connection,
+                                              GAsyncResult     *res,
+                                              GError          **error)
+{
+  GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (res);
+
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+  g_warn_if_fail (g_simple_async_result_get_source_tag (simple) == g_dbus_connection_invoke_method_batch);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 struct ExportedSubtree
 {
   guint                     id;
@@ -3774,6 +5548,7 @@ handle_subtree_method_invocation (DBusConnection *connection,
                                   DBusMessage    *message)
 {
   DBusHandlerResult result;
+  const MessageHeaders *headers;
   const gchar *sender;
   const gchar *interface_name;
   const gchar *requested_object_path;
@@ -3792,31 +5567,32 @@ handle_subtree_method_invocation (DBusConnection *connection,
   result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
   interfaces = NULL;
 
-  requested_object_path = dbus_message_get_path (message);
-  sender = dbus_message_get_sender (message);
-  interface_name = dbus_message_get_interface (message);
+  headers = message_headers_get (es->connection, message);
+  requested_object_path = headers->path;
+  sender = headers->sender;
+  interface_name = headers->interface_name;
   is_root = (g_strcmp0 (requested_object_path, es->object_path) == 0);
 
   is_property_get = FALSE;
   is_property_set = FALSE;
   is_property_get_all = FALSE;
-  if (dbus_message_is_method_call (message,
-                                   "org.freedesktop.DBus.Properties",
-                                   "Get") &&
+  if (message_headers_is_method_call (headers,
+                                      quark_interface_properties,
+                                      quark_member_get) &&
       g_strcmp0 (dbus_message_get_signature (message), "ss") == 0)
     {
       is_property_get = TRUE;
     }
-  else if (dbus_message_is_method_call (message,
-                                        "org.freedesktop.DBus.Properties",
-                                        "Set") &&
+  else if (message_headers_is_method_call (headers,
+                                           quark_interface_properties,
+                                           quark_member_set) &&
            g_strcmp0 (dbus_message_get_signature (message), "ssv") == 0)
     {
       is_property_set = TRUE;
     }
-  else if (dbus_message_is_method_call (message,
-                                        "org.freedesktop.DBus.Properties",
-                                        "GetAll") &&
+  else if (message_headers_is_method_call (headers,
+                                           quark_interface_properties,
+                                           quark_member_get_all) &&
            g_strcmp0 (dbus_message_get_signature (message), "s") == 0)
     {
       is_property_get_all = TRUE;
@@ -3875,10 +5651,13 @@ handle_subtree_method_invocation (DBusConnection *connection,
 
       result = validate_and_maybe_schedule_method_call (es->connection,
                                                         message,
+                                                        headers,
                                                         introspection_data,
+                                                        NULL,
                                                         interface_vtable,
                                                         es->context,
-                                                        interface_user_data);
+                                                        interface_user_data,
+                                                        NULL);
     }
   /* handle org.freedesktop.DBus.Properties interface if not explicitly handled */
   else if (is_property_get || is_property_set || is_property_get_all)
@@ -3931,6 +5710,7 @@ handle_subtree_method_invocation (DBusConnection *connection,
           result = validate_and_maybe_schedule_property_getset (es->connection,
                                                                 message,
                                                                 introspection_data,
+                                                                NULL,
                                                                 interface_vtable,
                                                                 es->context,
                                                                 interface_user_data);
@@ -4114,7 +5894,7 @@ g_dbus_connection_register_subtree (GDBusConnection            *connection,
 
   ret = 0;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   es = g_hash_table_lookup (connection->priv->map_object_path_to_es, object_path);
   if (es != NULL)
@@ -4159,7 +5939,7 @@ g_dbus_connection_register_subtree (GDBusConnection            *connection,
 
   es->vtable = vtable;
   es->flags = flags;
-  es->id = _global_subtree_registration_id++; /* TODO: overflow etc. */
+  es->id = g_atomic_int_exchange_and_add (&_global_subtree_registration_id, 1); /* TODO: overflow etc. */
   es->user_data = user_data;
   es->user_data_free_func = user_data_free_func;
   es->context = g_main_context_get_thread_default ();
@@ -4174,7 +5954,7 @@ g_dbus_connection_register_subtree (GDBusConnection            *connection,
   ret = es->id;
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   return ret;
 }
@@ -4201,7 +5981,7 @@ g_dbus_connection_unregister_subtree (GDBusConnection *connection,
 
   ret = FALSE;
 
-  G_LOCK (connection_lock);
+  CONNECTION_LOCK (connection);
 
   es = g_hash_table_lookup (connection->priv->map_id_to_es,
                             GUINT_TO_POINTER (registration_id));
@@ -4220,7 +6000,7 @@ g_dbus_connection_unregister_subtree (GDBusConnection *connection,
   ret = TRUE;
 
  out:
-  G_UNLOCK (connection_lock);
+  CONNECTION_UNLOCK (connection);
 
   return ret;
 }
@@ -120,6 +120,10 @@ gboolean         g_dbus_connection_get_is_private             (GDBusConnection
 gboolean         g_dbus_connection_get_is_disconnected        (GDBusConnection    *connection);
 void             g_dbus_connection_set_exit_on_disconnect     (GDBusConnection    *connection,
                                                                gboolean            exit_on_disconnect);
+void             g_dbus_connection_set_dispatch_budget        (GDBusConnection    *connection,
+                                                               guint               max_messages,
+                                                               guint               max_usec);
+void             g_dbus_enable_io_worker_thread               (void);
 void             g_dbus_connection_disconnect                 (GDBusConnection    *connection);
 
 /**
@@ -226,6 +230,7 @@ guint            g_dbus_connection_register_object            (GDBusConnection
                                                                const gchar                *interface_name,
                                                                const GDBusInterfaceInfo   *introspection_data,
                                                                const GDBusInterfaceVTable *vtable,
+                                                               GDBusRegisterObjectFlags    flags,
                                                                gpointer                    user_data,
                                                                GDestroyNotify              user_data_free_func,
                                                                GError                    **error);
@@ -332,6 +337,13 @@ gboolean  g_dbus_connection_emit_signal                       (GDBusConnection
                                                                const gchar        *signal_name,
                                                                GVariant           *parameters,
                                                                GError            **error);
+gboolean  g_dbus_connection_emit_signal_multi                 (GDBusConnection    *connection,
+                                                               const gchar *const *destination_bus_names,
+                                                               const gchar *const *object_paths,
+                                                               const gchar        *interface_name,
+                                                               const gchar        *signal_name,
+                                                               GVariant           *parameters,
+                                                               GError            **error);
 void      g_dbus_connection_invoke_method                     (GDBusConnection    *connection,
                                                                const gchar        *bus_name,
                                                                const gchar        *object_path,
@@ -355,6 +367,29 @@ GVariant *g_dbus_connection_invoke_method_sync                (GDBusConnection
                                                                GCancellable       *cancellable,
                                                                GError            **error);
 
+GDBusMethodCallBatch *g_dbus_method_call_batch_new            (void);
+GDBusMethodCallBatch *g_dbus_method_call_batch_ref            (GDBusMethodCallBatch *batch);
+void      g_dbus_method_call_batch_unref                      (GDBusMethodCallBatch *batch);
+guint     g_dbus_method_call_batch_add                        (GDBusMethodCallBatch *batch,
+                                                               const gchar          *bus_name,
+                                                               const gchar          *object_path,
+                                                               const gchar          *interface_name,
+                                                               const gchar          *method_name,
+                                                               GVariant             *parameters);
+guint     g_dbus_method_call_batch_get_n_calls                (GDBusMethodCallBatch *batch);
+GVariant *g_dbus_method_call_batch_get_result                 (GDBusMethodCallBatch *batch,
+                                                               guint                 index,
+                                                               GError              **error);
+void      g_dbus_connection_invoke_method_batch               (GDBusConnection      *connection,
+                                                               GDBusMethodCallBatch *batch,
+                                                               gint                  timeout_msec,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              user_data);
+gboolean  g_dbus_connection_invoke_method_batch_finish        (GDBusConnection      *connection,
+                                                               GAsyncResult         *res,
+                                                               GError              **error);
+
 /**
  * GDBusSignalCallback:
  * @connection: A #GDBusConnection.
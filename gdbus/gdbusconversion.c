@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <glib/gi18n.h>
 
@@ -34,6 +35,37 @@
 #include "gdbusenums.h"
 #include "gdbusprivate.h"
 
+/* Returns the size of an element of @type_char if arrays of it can be
+ * moved between libdbus and GVariant with a single copy, 0 otherwise.
+ * Booleans are excluded since libdbus uses 4 bytes per value and
+ * GVariant uses 1.
+ */
+static gsize
+fixed_array_element_size (gchar type_char)
+{
+  switch (type_char)
+    {
+    case DBUS_TYPE_BYTE:
+      return 1;
+
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return 2;
+
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      return 4;
+
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+      return 8;
+
+    default:
+      return 0;
+    }
+}
+
 static gboolean
 dconf_dbus_from_gv (DBusMessageIter  *iter,
                     GVariant         *value,
@@ -150,12 +182,31 @@ dconf_dbus_from_gv (DBusMessageIter  *iter,
         const gchar *type_string;
         GVariantIter gv_iter;
         GVariant *item;
+        gsize element_size;
 
         type_string = g_variant_get_type_string (value);
         type_string++; /* skip the 'a' */
 
         dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY,
                                           type_string, &dbus_iter);
+
+        /* fast path: copy arrays of fixed-size basic types in one go */
+        element_size = fixed_array_element_size (type_string[0]);
+        if (element_size > 0)
+          {
+            gconstpointer data;
+            gsize n_elements;
+
+            data = g_variant_get_fixed_array (value, element_size, &n_elements);
+            if (n_elements > 0)
+              dbus_message_iter_append_fixed_array (&dbus_iter,
+                                                    type_string[0],
+                                                    &data,
+                                                    n_elements);
+            dbus_message_iter_close_container (iter, &dbus_iter);
+            break;
+          }
+
         g_variant_iter_init (&gv_iter, value);
 
         while ((item = g_variant_iter_next_value (&gv_iter)))
@@ -232,158 +283,468 @@ dconf_dbus_from_gv (DBusMessageIter  *iter,
   return FALSE;
 }
 
-static GVariant *
-dconf_dbus_to_gv (DBusMessageIter  *iter,
-                  GError          **error)
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Direct serialisation of a D-Bus message body into the GVariant
+ * serialised format.
+ *
+ * Instead of building a tree of individually allocated GVariant
+ * instances and letting GVariant serialise it on demand, the message is
+ * written into a single buffer that is then wrapped with
+ * g_variant_from_data().  Children of the result are then cheap views
+ * into that buffer.
+ *
+ * The layout rules mirror the ones in gvariant-serialiser.c: every value
+ * is aligned relative to the start of its container (which is itself
+ * aligned to the largest alignment of its contents, so aligning on the
+ * absolute buffer offset is equivalent), and variable-sized containers
+ * store the end offsets of their children in a trailing array whose
+ * item size depends on the total size of the container.
+ */
+
+static const gchar *
+signature_skip_complete_type (const gchar *signature)
+{
+  gchar close;
+
+  switch (*signature)
+    {
+    case 'a':
+      return signature_skip_complete_type (signature + 1);
+
+    case '(':
+    case '{':
+      close = (*signature == '(') ? ')' : '}';
+      signature++;
+      while (*signature != close && *signature != '\0')
+        signature = signature_skip_complete_type (signature);
+      return signature + 1;
+
+    default:
+      return signature + 1;
+    }
+}
+
+/* alignment is returned as a mask (ie: 7 for 8-byte alignment) and
+ * fixed_size is 0 for variable-sized types, like g_variant_type_info_query()
+ */
+static void
+signature_query (const gchar *signature,
+                 guint       *alignment,
+                 gsize       *fixed_size)
+{
+  switch (*signature)
+    {
+    case 'y':
+    case 'b':
+      *alignment = 0;
+      *fixed_size = 1;
+      break;
+
+    case 'n':
+    case 'q':
+      *alignment = 1;
+      *fixed_size = 2;
+      break;
+
+    case 'i':
+    case 'u':
+      *alignment = 3;
+      *fixed_size = 4;
+      break;
+
+    case 'x':
+    case 't':
+    case 'd':
+      *alignment = 7;
+      *fixed_size = 8;
+      break;
+
+    case 'v':
+      *alignment = 7;
+      *fixed_size = 0;
+      break;
+
+    case 'a':
+      signature_query (signature + 1, alignment, fixed_size);
+      *fixed_size = 0;
+      break;
+
+    case '(':
+    case '{':
+      {
+        const gchar *member;
+        gboolean all_fixed;
+        gsize offset;
+
+        *alignment = 0;
+        all_fixed = TRUE;
+        offset = 0;
+        for (member = signature + 1;
+             *member != ')' && *member != '}' && *member != '\0';
+             member = signature_skip_complete_type (member))
+          {
+            guint member_alignment;
+            gsize member_fixed_size;
+
+            signature_query (member, &member_alignment, &member_fixed_size);
+            *alignment |= member_alignment;
+            if (member_fixed_size == 0)
+              all_fixed = FALSE;
+            offset += (-offset) & member_alignment;
+            offset += member_fixed_size;
+          }
+
+        if (all_fixed)
+          {
+            offset += (-offset) & *alignment;
+            /* the unit tuple takes up one byte */
+            *fixed_size = offset > 0 ? offset : 1;
+          }
+        else
+          {
+            *fixed_size = 0;
+          }
+      }
+      break;
+
+    default:
+      /* strings and anything we don't know about */
+      *alignment = 0;
+      *fixed_size = 0;
+      break;
+    }
+}
+
+static guint
+serialised_offset_size (gsize container_size)
+{
+  if (container_size > G_MAXUINT32)
+    return 8;
+  else if (container_size > G_MAXUINT16)
+    return 4;
+  else if (container_size > G_MAXUINT8)
+    return 2;
+  else if (container_size > 0)
+    return 1;
+  return 0;
+}
+
+static gsize
+serialised_total_size (gsize body_size,
+                       gsize n_offsets)
+{
+  if (body_size + 1 * n_offsets <= G_MAXUINT8)
+    return body_size + 1 * n_offsets;
+  if (body_size + 2 * n_offsets <= G_MAXUINT16)
+    return body_size + 2 * n_offsets;
+  if (body_size + 4 * n_offsets <= G_MAXUINT32)
+    return body_size + 4 * n_offsets;
+  return body_size + 8 * n_offsets;
+}
+
+static void
+buffer_pad (GByteArray *buffer,
+            gsize       size)
+{
+  gsize old_len;
+
+  old_len = buffer->len;
+  if (size <= old_len)
+    return;
+  g_byte_array_set_size (buffer, size);
+  memset (buffer->data + old_len, 0, size - old_len);
+}
+
+static void
+buffer_align (GByteArray *buffer,
+              guint       alignment)
+{
+  buffer_pad (buffer, buffer->len + ((-(gsize) buffer->len) & alignment));
+}
+
+static void
+buffer_append_offset (GByteArray *buffer,
+                      gsize       offset,
+                      guint       offset_size)
+{
+  union
+  {
+    guchar bytes[GLIB_SIZEOF_SIZE_T];
+    gsize integer;
+  } tmpvalue;
+
+  tmpvalue.integer = GSIZE_TO_LE (offset);
+  g_byte_array_append (buffer, tmpvalue.bytes, offset_size);
+}
+
+static gboolean serialise_value (GByteArray       *buffer,
+                                 DBusMessageIter  *iter,
+                                 const gchar      *signature,
+                                 GError          **error);
+
+/* @iter points to the first member, @signature to the opening bracket */
+static gboolean
+serialise_tuple (GByteArray       *buffer,
+                 DBusMessageIter  *iter,
+                 const gchar      *signature,
+                 GError          **error)
+{
+  gsize stack_offsets[8];
+  gsize *offsets;
+  gsize n_offsets;
+  gsize max_offsets;
+  const gchar *member;
+  guint alignment;
+  gsize fixed_size;
+  gsize start;
+  gboolean ret;
+
+  ret = FALSE;
+
+  signature_query (signature, &alignment, &fixed_size);
+  buffer_align (buffer, alignment);
+  start = buffer->len;
+
+  offsets = stack_offsets;
+  max_offsets = G_N_ELEMENTS (stack_offsets);
+  n_offsets = 0;
+
+  member = signature + 1;
+  while (*member != ')' && *member != '}')
+    {
+      const gchar *next;
+      guint member_alignment;
+      gsize member_fixed_size;
+
+      next = signature_skip_complete_type (member);
+
+      if (!serialise_value (buffer, iter, member, error))
+        goto out;
+      dbus_message_iter_next (iter);
+
+      /* every variable-sized member except the last one gets a framing offset */
+      signature_query (member, &member_alignment, &member_fixed_size);
+      if (member_fixed_size == 0 && *next != ')' && *next != '}')
+        {
+          if (n_offsets == max_offsets)
+            {
+              if (offsets == stack_offsets)
+                offsets = g_memdup (stack_offsets, sizeof stack_offsets);
+              max_offsets *= 2;
+              offsets = g_renew (gsize, offsets, max_offsets);
+            }
+          offsets[n_offsets++] = buffer->len - start;
+        }
+
+      member = next;
+    }
+
+  if (fixed_size > 0)
+    {
+      buffer_pad (buffer, start + fixed_size);
+    }
+  else
+    {
+      guint offset_size;
+      gsize n;
+
+      offset_size = serialised_offset_size (serialised_total_size (buffer->len - start, n_offsets));
+
+      /* the offsets of a tuple are stored back to front */
+      for (n = n_offsets; n > 0; n--)
+        buffer_append_offset (buffer, offsets[n - 1], offset_size);
+    }
+
+  ret = TRUE;
+
+ out:
+  if (offsets != stack_offsets)
+    g_free (offsets);
+  return ret;
+}
+
+static gboolean
+serialise_array (GByteArray       *buffer,
+                 DBusMessageIter  *iter,
+                 const gchar      *signature,
+                 GError          **error)
+{
+  DBusMessageIter sub;
+  const gchar *element_signature;
+  guint alignment;
+  gsize fixed_size;
+  gsize start;
+  GArray *offsets;
+  gboolean ret;
+
+  ret = FALSE;
+  offsets = NULL;
+
+  element_signature = signature + 1;
+  signature_query (element_signature, &alignment, &fixed_size);
+  buffer_align (buffer, alignment);
+  start = buffer->len;
+
+  dbus_message_iter_recurse (iter, &sub);
+
+  /* fast path: the libdbus and GVariant representations of arrays of
+   * fixed-size basic types are the same, so just copy the whole thing
+   */
+  if (fixed_array_element_size (*element_signature) > 0)
+    {
+      gconstpointer data;
+      int n_elements;
+
+      dbus_message_iter_get_fixed_array (&sub, &data, &n_elements);
+      if (n_elements > 0)
+        g_byte_array_append (buffer, data, n_elements * fixed_size);
+      ret = TRUE;
+      goto out;
+    }
+
+  if (fixed_size == 0)
+    offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  while (dbus_message_iter_get_arg_type (&sub) != DBUS_TYPE_INVALID)
+    {
+      if (!serialise_value (buffer, &sub, element_signature, error))
+        goto out;
+      dbus_message_iter_next (&sub);
+
+      if (offsets != NULL)
+        {
+          gsize end;
+          end = buffer->len - start;
+          g_array_append_val (offsets, end);
+        }
+    }
+
+  if (offsets != NULL)
+    {
+      guint offset_size;
+      guint n;
+
+      offset_size = serialised_offset_size (serialised_total_size (buffer->len - start, offsets->len));
+      for (n = 0; n < offsets->len; n++)
+        buffer_append_offset (buffer, g_array_index (offsets, gsize, n), offset_size);
+    }
+
+  ret = TRUE;
+
+ out:
+  if (offsets != NULL)
+    g_array_free (offsets, TRUE);
+  return ret;
+}
+
+static gboolean
+serialise_value (GByteArray       *buffer,
+                 DBusMessageIter  *iter,
+                 const gchar      *signature,
+                 GError          **error)
 {
   gint arg_type;
 
   arg_type = dbus_message_iter_get_arg_type (iter);
 
-  switch (dbus_message_iter_get_arg_type (iter))
+  switch (arg_type)
     {
      case DBUS_TYPE_BOOLEAN:
       {
         dbus_bool_t value;
+        guint8 v;
         dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_boolean (value);
+        v = (value != FALSE);
+        g_byte_array_append (buffer, &v, 1);
+        break;
       }
 
      case DBUS_TYPE_BYTE:
       {
-        guchar value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_byte (value);
+        guint8 v;
+        dbus_message_iter_get_basic (iter, &v);
+        g_byte_array_append (buffer, &v, 1);
+        break;
       }
 
      case DBUS_TYPE_INT16:
-      {
-        gint16 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_int16 (value);
-      }
-
      case DBUS_TYPE_UINT16:
       {
-        guint16 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_uint16 (value);
+        guint16 v;
+        dbus_message_iter_get_basic (iter, &v);
+        buffer_align (buffer, 1);
+        g_byte_array_append (buffer, (const guint8 *) &v, 2);
+        break;
       }
 
      case DBUS_TYPE_INT32:
-      {
-        gint32 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_int32 (value);
-      }
-
      case DBUS_TYPE_UINT32:
       {
-        guint32 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_uint32 (value);
+        guint32 v;
+        dbus_message_iter_get_basic (iter, &v);
+        buffer_align (buffer, 3);
+        g_byte_array_append (buffer, (const guint8 *) &v, 4);
+        break;
       }
 
      case DBUS_TYPE_INT64:
-      {
-        gint64 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_int64 (value);
-      }
-
      case DBUS_TYPE_UINT64:
-      {
-        guint64 value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_uint64 (value);
-      }
-
      case DBUS_TYPE_DOUBLE:
       {
-        gdouble value;
-        dbus_message_iter_get_basic (iter, &value);
-        return g_variant_new_double (value);
+        guint64 v;
+        dbus_message_iter_get_basic (iter, &v);
+        buffer_align (buffer, 7);
+        g_byte_array_append (buffer, (const guint8 *) &v, 8);
+        break;
       }
 
      case DBUS_TYPE_STRING:
-      {
-       const gchar *value;
-       dbus_message_iter_get_basic (iter, &value);
-       return g_variant_new_string (value);
-      }
-
      case DBUS_TYPE_OBJECT_PATH:
-      {
-       const gchar *value;
-       dbus_message_iter_get_basic (iter, &value);
-       return g_variant_new_object_path (value);
-      }
-
      case DBUS_TYPE_SIGNATURE:
       {
-       const gchar *value;
-       dbus_message_iter_get_basic (iter, &value);
-       return g_variant_new_signature (value);
+        const gchar *v;
+        dbus_message_iter_get_basic (iter, &v);
+        g_byte_array_append (buffer, (const guint8 *) v, strlen (v) + 1);
+        break;
       }
 
      case DBUS_TYPE_VARIANT:
-       {
-        GVariantBuilder *builder;
-        GVariantClass class;
+      {
         DBusMessageIter sub;
-        char *type;
-        GVariant *val;
+        char *child_signature;
+        gboolean ok;
 
+        buffer_align (buffer, 7);
         dbus_message_iter_recurse (iter, &sub);
-        class = dbus_message_iter_get_arg_type (iter);
-        type = dbus_message_iter_get_signature (&sub);
-        builder = g_variant_builder_new (G_VARIANT_TYPE_VARIANT);
-        dbus_free (type);
-
-        while (dbus_message_iter_get_arg_type (&sub))
+        child_signature = dbus_message_iter_get_signature (&sub);
+        ok = serialise_value (buffer, &sub, child_signature, error);
+        if (ok)
           {
-            val = dconf_dbus_to_gv (&sub, error);
-            if (val == NULL)
-              {
-                g_variant_builder_cancel (builder);
-                goto fail;
-              }
-            g_variant_builder_add_value (builder, val);
-            dbus_message_iter_next (&sub);
+            /* the type string of the child follows a nul separator */
+            g_byte_array_append (buffer, (const guint8 *) "", 1);
+            g_byte_array_append (buffer, (const guint8 *) child_signature, strlen (child_signature));
           }
-
-        return g_variant_builder_end (builder);
-       }
+        dbus_free (child_signature);
+        if (!ok)
+          goto fail;
+        break;
+      }
 
      case DBUS_TYPE_ARRAY:
+      if (!serialise_array (buffer, iter, signature, error))
+        goto fail;
+      break;
+
      case DBUS_TYPE_STRUCT:
      case DBUS_TYPE_DICT_ENTRY:
       {
-        GVariantBuilder *builder;
-        GVariantClass class;
         DBusMessageIter sub;
-        char *type;
-        GVariant *val;
 
         dbus_message_iter_recurse (iter, &sub);
-        class = dbus_message_iter_get_arg_type (iter);
-        type = dbus_message_iter_get_signature (iter);
-        builder = g_variant_builder_new (G_VARIANT_TYPE (type));
-        dbus_free (type);
-
-        while (dbus_message_iter_get_arg_type (&sub))
-          {
-            val = dconf_dbus_to_gv (&sub, error);
-            if (val == NULL)
-              {
-                g_variant_builder_cancel (builder);
-                goto fail;
-              }
-            g_variant_builder_add_value (builder, val);
-            dbus_message_iter_next (&sub);
-          }
-
-        return g_variant_builder_end (builder);
+        if (!serialise_tuple (buffer, &sub, signature, error))
+          goto fail;
+        break;
       }
 
      default:
@@ -393,13 +754,35 @@ dconf_dbus_to_gv (DBusMessageIter  *iter,
                     _("Error serializing D-Bus message to GVariant. Unsupported arg type `%c' (%d)"),
                     arg_type,
                     arg_type);
-      goto fail;
+       goto fail;
     }
 
-  g_assert_not_reached ();
+  return TRUE;
 
  fail:
-  return NULL;
+  return FALSE;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gboolean
+set_error_from_message (DBusMessage  *message,
+                        GError      **error)
+{
+  DBusError dbus_error;
+
+  dbus_error_init (&dbus_error);
+  if (dbus_set_error_from_message (&dbus_error, message))
+    {
+      g_dbus_error_set_dbus_error (error,
+                                   dbus_error.name,
+                                   dbus_error.message,
+                                   NULL);
+      dbus_error_free (&dbus_error);
+      return TRUE;
+    }
+
+  return FALSE;
 }
 
 /**
@@ -411,60 +794,52 @@ dconf_dbus_to_gv (DBusMessageIter  *iter,
  * @error with the contents of the error using
  * g_dbus_error_set_dbus_error().
  *
- * Otherwise build a #GVariant with the message (this never fails).
+ * Otherwise build a #GVariant tuple with the body of @message. The
+ * body is serialised into a single buffer so children of the returned
+ * value are only created, as views into that buffer, when accessed.
  *
- * Returns: A #GVariant or %NULL if @error is set.
+ * Returns: A non-floating #GVariant or %NULL if @error is set. Free with g_variant_unref().
  **/
 GVariant *
 _g_dbus_dbus_1_to_gvariant (DBusMessage  *message,
                             GError      **error)
 {
   DBusMessageIter iter;
-  GVariantBuilder *builder;
-  guint n;
+  GByteArray *buffer;
+  gchar *tuple_signature;
   GVariant *result;
-  DBusError dbus_error;
+  gsize size;
+  gpointer data;
 
   g_assert (message != NULL);
 
   result = NULL;
 
-  dbus_error_init (&dbus_error);
-  if (dbus_set_error_from_message (&dbus_error, message))
-    {
-      g_dbus_error_set_dbus_error (error,
-                                   dbus_error.name,
-                                   dbus_error.message,
-                                   NULL);
-      dbus_error_free (&dbus_error);
-      goto out;
-    }
+  if (set_error_from_message (message, error))
+    goto out;
 
-  dbus_message_iter_init (message, &iter);
+  tuple_signature = g_strdup_printf ("(%s)", dbus_message_get_signature (message));
 
-  builder = g_variant_builder_new (G_VARIANT_TYPE_TUPLE);
-  n = 0;
-  while (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_INVALID)
+  dbus_message_iter_init (message, &iter);
+  buffer = g_byte_array_new ();
+  if (!serialise_tuple (buffer, &iter, tuple_signature, error))
     {
-      GVariant *item;
-
-      item = dconf_dbus_to_gv (&iter, error);
-      if (item == NULL)
-        {
-          g_variant_builder_cancel (builder);
-          g_prefix_error (error,
-                          _("Error decoding out-arg %d: "),
-                          n);
-          goto out;
-        }
-      g_variant_builder_add_value (builder, item);
-      dbus_message_iter_next (&iter);
+      g_byte_array_free (buffer, TRUE);
+      g_free (tuple_signature);
+      goto out;
     }
 
-  result = g_variant_builder_end (builder);
+  size = buffer->len;
+  data = g_byte_array_free (buffer, FALSE);
+  result = g_variant_from_data (G_VARIANT_TYPE (tuple_signature),
+                                data,
+                                size,
+                                0,
+                                g_free,
+                                data);
+  g_free (tuple_signature);
 
  out:
-
   return result;
 }
 
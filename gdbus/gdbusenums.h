@@ -257,6 +257,30 @@ typedef enum
   G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE = (1<<1),
 } GDBusPropertyInfoFlags;
 
+/**
+ * GDBusRegisterObjectFlags:
+ * @G_DBUS_REGISTER_OBJECT_FLAGS_NONE: No flags set.
+ * @G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH: If the thread receiving a method call already owns the
+ *                                               #GMainContext the object was registered in, invoke the
+ *                                               handler right away instead of from an idle source. This
+ *                                               saves a main loop iteration per method call.
+ * @G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL: Invoke method call handlers in a worker thread from
+ *                                                       a bounded thread pool. Takes precedence over
+ *                                                       %G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH.
+ * @G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER: Used with %G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL
+ *                                                 to handle method calls one at a time, in the order they
+ *                                                 were received.
+ *
+ * Flags passed to g_dbus_connection_register_object().
+ */
+typedef enum
+{
+  G_DBUS_REGISTER_OBJECT_FLAGS_NONE = 0,
+  G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH = (1<<0),
+  G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL = (1<<1),
+  G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER = (1<<2),
+} GDBusRegisterObjectFlags;
+
 /**
  * GDBusSubtreeFlags:
  * @G_DBUS_SUBTREE_FLAGS_NONE: No flags set.
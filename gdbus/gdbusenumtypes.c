@@ -233,6 +233,28 @@ g_dbus_property_info_flags_get_type (void)
   return g_define_type_id__volatile;
 }
 
+GType
+g_dbus_register_object_flags_get_type (void)
+{
+  static volatile gsize g_define_type_id__volatile = 0;
+
+  if (g_once_init_enter (&g_define_type_id__volatile))
+    {
+      static const GFlagsValue values[] = {
+        { G_DBUS_REGISTER_OBJECT_FLAGS_NONE, "G_DBUS_REGISTER_OBJECT_FLAGS_NONE", "none" },
+        { G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH, "G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH", "direct-dispatch" },
+        { G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL, "G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL", "dispatch-in-thread-pool" },
+        { G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER, "G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER", "dispatch-in-order" },
+        { 0, NULL, NULL }
+      };
+      GType g_define_type_id =
+        g_flags_register_static (g_intern_static_string ("GDBusRegisterObjectFlags"), values);
+      g_once_init_leave (&g_define_type_id__volatile, g_define_type_id);
+    }
+
+  return g_define_type_id__volatile;
+}
+
 GType
 g_dbus_subtree_flags_get_type (void)
 {
@@ -27,6 +27,8 @@ GType g_dbus_error_get_type (void) G_GNUC_CONST;
 #define G_TYPE_DBUS_ERROR (g_dbus_error_get_type ())
 GType g_dbus_property_info_flags_get_type (void) G_GNUC_CONST;
 #define G_TYPE_DBUS_PROPERTY_INFO_FLAGS (g_dbus_property_info_flags_get_type ())
+GType g_dbus_register_object_flags_get_type (void) G_GNUC_CONST;
+#define G_TYPE_DBUS_REGISTER_OBJECT_FLAGS (g_dbus_register_object_flags_get_type ())
 GType g_dbus_subtree_flags_get_type (void) G_GNUC_CONST;
 #define G_TYPE_DBUS_SUBTREE_FLAGS (g_dbus_subtree_flags_get_type ())
 G_END_DECLS
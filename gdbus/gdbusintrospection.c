@@ -23,10 +23,13 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <glib/gi18n.h>
 
 #include "gdbusintrospection.h"
+#include "gdbusprivate.h"
+#include "gvarianttypeinfo.h"
 
 /**
  * SECTION:gdbusintrospection
@@ -1679,6 +1682,423 @@ g_dbus_annotation_info_lookup (const GDBusAnnotationInfo *annotations,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static GVariantTypeInfo *
+tuple_type_info_for_signature (const gchar *signature)
+{
+  GVariantTypeInfo *info;
+  gchar *tuple_signature;
+
+  info = NULL;
+  tuple_signature = g_strdup_printf ("(%s)", signature != NULL ? signature : "");
+  if (g_variant_type_string_is_valid (tuple_signature))
+    info = g_variant_type_info_get (G_VARIANT_TYPE (tuple_signature));
+  g_free (tuple_signature);
+
+  return info;
+}
+
+/* Never modified after _g_dbus_interface_info_index_new() returns so it can be
+ * read from any thread without a lock
+ */
+struct _GDBusInterfaceInfoIndex
+{
+  const GDBusInterfaceInfo *interface_info;
+
+  /* The interned tuple types for the in and out signatures of each method,
+   * indexed like interface_info->methods - NULL if the signature is not valid
+   */
+  GVariantTypeInfo **in_type_infos;
+  GVariantTypeInfo **out_type_infos;
+
+  /* gchar* -> const GDBusMethodInfo* */
+  GHashTable *method_name_to_data;
+
+  /* gchar* -> const GDBusSignalInfo* */
+  GHashTable *signal_name_to_data;
+
+  /* gchar* -> const GDBusPropertyInfo* */
+  GHashTable *property_name_to_data;
+};
+
+/**
+ * _g_dbus_interface_info_index_new:
+ * @interface_info: A #GDBusInterfaceInfo.
+ *
+ * Builds hash tables for looking up the methods, signals and
+ * properties of @interface_info by name and interns the tuple types
+ * of the method signatures. The index is immutable so lookups need
+ * no locking; @interface_info must outlive it.
+ *
+ * Returns: A #GDBusInterfaceInfoIndex. Free with _g_dbus_interface_info_index_free().
+ */
+GDBusInterfaceInfoIndex *
+_g_dbus_interface_info_index_new (const GDBusInterfaceInfo *interface_info)
+{
+  GDBusInterfaceInfoIndex *index;
+  guint n;
+
+  index = g_slice_new0 (GDBusInterfaceInfoIndex);
+  index->interface_info = interface_info;
+  index->in_type_infos = g_new0 (GVariantTypeInfo *, interface_info->num_methods);
+  index->out_type_infos = g_new0 (GVariantTypeInfo *, interface_info->num_methods);
+  for (n = 0; n < interface_info->num_methods; n++)
+    {
+      index->in_type_infos[n] = tuple_type_info_for_signature (interface_info->methods[n].in_signature);
+      index->out_type_infos[n] = tuple_type_info_for_signature (interface_info->methods[n].out_signature);
+    }
+  index->method_name_to_data = g_hash_table_new (g_str_hash, g_str_equal);
+  index->signal_name_to_data = g_hash_table_new (g_str_hash, g_str_equal);
+  index->property_name_to_data = g_hash_table_new (g_str_hash, g_str_equal);
+  /* iterate backwards so that the first entry wins on duplicate names, like a linear search would */
+  for (n = interface_info->num_methods; n > 0; n--)
+    g_hash_table_insert (index->method_name_to_data,
+                         (gpointer) interface_info->methods[n - 1].name,
+                         (gpointer) &(interface_info->methods[n - 1]));
+  for (n = interface_info->num_signals; n > 0; n--)
+    g_hash_table_insert (index->signal_name_to_data,
+                         (gpointer) interface_info->signals[n - 1].name,
+                         (gpointer) &(interface_info->signals[n - 1]));
+  for (n = interface_info->num_properties; n > 0; n--)
+    g_hash_table_insert (index->property_name_to_data,
+                         (gpointer) interface_info->properties[n - 1].name,
+                         (gpointer) &(interface_info->properties[n - 1]));
+
+  return index;
+}
+
+/**
+ * _g_dbus_interface_info_index_free:
+ * @index: A #GDBusInterfaceInfoIndex.
+ *
+ * Frees @index.
+ */
+void
+_g_dbus_interface_info_index_free (GDBusInterfaceInfoIndex *index)
+{
+  guint n;
+
+  for (n = 0; n < index->interface_info->num_methods; n++)
+    {
+      if (index->in_type_infos[n] != NULL)
+        g_variant_type_info_unref (index->in_type_infos[n]);
+      if (index->out_type_infos[n] != NULL)
+        g_variant_type_info_unref (index->out_type_infos[n]);
+    }
+  g_free (index->in_type_infos);
+  g_free (index->out_type_infos);
+  g_hash_table_unref (index->method_name_to_data);
+  g_hash_table_unref (index->signal_name_to_data);
+  g_hash_table_unref (index->property_name_to_data);
+  g_slice_free (GDBusInterfaceInfoIndex, index);
+}
+
+/**
+ * _g_dbus_interface_info_index_lookup_method:
+ * @index: A #GDBusInterfaceInfoIndex.
+ * @name: A D-Bus method name or %NULL.
+ *
+ * Like g_dbus_interface_info_lookup_method() but uses @index.
+ *
+ * Returns: A #GDBusMethodInfo or %NULL if not found.
+ */
+const GDBusMethodInfo *
+_g_dbus_interface_info_index_lookup_method (const GDBusInterfaceInfoIndex *index,
+                                            const gchar                   *name)
+{
+  return name != NULL ? g_hash_table_lookup (index->method_name_to_data, name) : NULL;
+}
+
+/**
+ * _g_dbus_interface_info_index_lookup_signal:
+ * @index: A #GDBusInterfaceInfoIndex.
+ * @name: A D-Bus signal name or %NULL.
+ *
+ * Like g_dbus_interface_info_lookup_signal() but uses @index.
+ *
+ * Returns: A #GDBusSignalInfo or %NULL if not found.
+ */
+const GDBusSignalInfo *
+_g_dbus_interface_info_index_lookup_signal (const GDBusInterfaceInfoIndex *index,
+                                            const gchar                   *name)
+{
+  return name != NULL ? g_hash_table_lookup (index->signal_name_to_data, name) : NULL;
+}
+
+/**
+ * _g_dbus_interface_info_index_lookup_property:
+ * @index: A #GDBusInterfaceInfoIndex.
+ * @name: A D-Bus property name or %NULL.
+ *
+ * Like g_dbus_interface_info_lookup_property() but uses @index.
+ *
+ * Returns: A #GDBusPropertyInfo or %NULL if not found.
+ */
+const GDBusPropertyInfo *
+_g_dbus_interface_info_index_lookup_property (const GDBusInterfaceInfoIndex *index,
+                                              const gchar                   *name)
+{
+  return name != NULL ? g_hash_table_lookup (index->property_name_to_data, name) : NULL;
+}
+
+/**
+ * _g_dbus_interface_info_index_get_method_types:
+ * @index: A #GDBusInterfaceInfoIndex.
+ * @method_info: A #GDBusMethodInfo from the interface @index was built for.
+ * @out_in_type_info: Return location for the in tuple type or %NULL.
+ * @out_out_type_info: Return location for the out tuple type or %NULL.
+ *
+ * Gets the interned tuple types for the in and out signatures of
+ * @method_info. These are owned by @index and are %NULL if the
+ * signature is not valid.
+ */
+void
+_g_dbus_interface_info_index_get_method_types (const GDBusInterfaceInfoIndex  *index,
+                                               const GDBusMethodInfo          *method_info,
+                                               GVariantTypeInfo              **out_in_type_info,
+                                               GVariantTypeInfo              **out_out_type_info)
+{
+  guint n;
+
+  n = method_info - index->interface_info->methods;
+  g_assert (n < index->interface_info->num_methods);
+
+  if (out_in_type_info != NULL)
+    *out_in_type_info = index->in_type_infos[n];
+  if (out_out_type_info != NULL)
+    *out_out_type_info = index->out_type_infos[n];
+}
+
+typedef struct
+{
+  gint use_count;
+  GDBusInterfaceInfoIndex *index;
+} InfoCacheEntry;
+
+static void
+info_cache_free (InfoCacheEntry *cache)
+{
+  g_assert (cache->use_count == 0);
+  _g_dbus_interface_info_index_free (cache->index);
+  g_slice_free (InfoCacheEntry, cache);
+}
+
+/* maps from const GDBusInterfaceInfo* to InfoCacheEntry* */
+G_LOCK_DEFINE_STATIC (info_cache_lock);
+static GHashTable *info_cache = NULL;
+
+/* number of entries in info_cache - lets lookups skip the lock when no cache was ever built */
+static volatile gint info_cache_size = 0;
+
+/**
+ * g_dbus_interface_info_cache_build:
+ * @interface_info: A #GDBusInterfaceInfo.
+ *
+ * Builds a lookup-cache to speed up
+ * g_dbus_interface_info_lookup_method(),
+ * g_dbus_interface_info_lookup_signal() and
+ * g_dbus_interface_info_lookup_property().
+ *
+ * If this has already been called with @interface_info, then
+ * only the use count of the existing cache is increased. Each call
+ * must be paired with a call to g_dbus_interface_info_cache_release()
+ * and @interface_info must not be freed or modified while the cache
+ * is in use.
+ *
+ * Note that g_dbus_connection_register_object() keeps its own index
+ * for the interfaces it exports, so there is no need to call this
+ * function for dispatching incoming method calls to be fast.
+ */
+void
+g_dbus_interface_info_cache_build (const GDBusInterfaceInfo *interface_info)
+{
+  InfoCacheEntry *cache;
+
+  g_return_if_fail (interface_info != NULL);
+
+  G_LOCK (info_cache_lock);
+
+  if (info_cache == NULL)
+    info_cache = g_hash_table_new_full (g_direct_hash,
+                                        g_direct_equal,
+                                        NULL,
+                                        (GDestroyNotify) info_cache_free);
+
+  cache = g_hash_table_lookup (info_cache, interface_info);
+  if (cache != NULL)
+    {
+      cache->use_count += 1;
+      goto out;
+    }
+
+  cache = g_slice_new0 (InfoCacheEntry);
+  cache->use_count = 1;
+  cache->index = _g_dbus_interface_info_index_new (interface_info);
+  g_hash_table_insert (info_cache, (gpointer) interface_info, cache);
+  g_atomic_int_inc (&info_cache_size);
+
+ out:
+  G_UNLOCK (info_cache_lock);
+}
+
+/**
+ * g_dbus_interface_info_cache_release:
+ * @interface_info: A #GDBusInterfaceInfo.
+ *
+ * Decrements the use count of the lookup-cache built with
+ * g_dbus_interface_info_cache_build() for @interface_info and frees
+ * it when the use count drops to zero.
+ */
+void
+g_dbus_interface_info_cache_release (const GDBusInterfaceInfo *interface_info)
+{
+  InfoCacheEntry *cache;
+
+  g_return_if_fail (interface_info != NULL);
+
+  G_LOCK (info_cache_lock);
+
+  cache = info_cache != NULL ? g_hash_table_lookup (info_cache, interface_info) : NULL;
+  if (G_UNLIKELY (cache == NULL))
+    {
+      g_warning ("%s called for interface %s but there is no cache",
+                 G_STRFUNC,
+                 interface_info->name);
+      goto out;
+    }
+
+  cache->use_count -= 1;
+  if (cache->use_count == 0)
+    {
+      g_hash_table_remove (info_cache, interface_info);
+      g_atomic_int_add (&info_cache_size, -1);
+    }
+
+ out:
+  G_UNLOCK (info_cache_lock);
+}
+
+/* Looks up @name in the cache for @interface_info; sets @out_data and
+ * returns %TRUE if there is a cache, returns %FALSE otherwise
+ */
+static gboolean
+info_cache_lookup (const GDBusInterfaceInfo *interface_info,
+                   gsize                     table_offset,
+                   const gchar              *name,
+                   gconstpointer            *out_data)
+{
+  InfoCacheEntry *cache;
+  gboolean ret;
+
+  ret = FALSE;
+
+  /* Lock-free fast path for the common case of no cache at all. Racing with
+   * g_dbus_interface_info_cache_build() only means doing a linear search.
+   */
+  if (g_atomic_int_get (&info_cache_size) == 0)
+    goto out;
+
+  G_LOCK (info_cache_lock);
+  if (G_LIKELY (info_cache != NULL))
+    {
+      cache = g_hash_table_lookup (info_cache, interface_info);
+      if (cache != NULL)
+        {
+          GHashTable *table;
+          table = G_STRUCT_MEMBER (GHashTable *, cache->index, table_offset);
+          *out_data = name != NULL ? g_hash_table_lookup (table, name) : NULL;
+          ret = TRUE;
+        }
+    }
+  G_UNLOCK (info_cache_lock);
+
+ out:
+  return ret;
+}
+
+/* Returns %TRUE if @type is the tuple type of @signature, e.g. "(sa{sv})"
+ * for "sa{sv}" - without building the tuple type string
+ */
+static gboolean
+type_is_tuple_of_signature (const GVariantType *type,
+                            const gchar        *signature)
+{
+  const gchar *type_string;
+  gsize len;
+
+  type_string = g_variant_type_peek_string (type);
+  if (signature == NULL)
+    signature = "";
+  len = strlen (signature);
+
+  return g_variant_type_get_string_length (type) == len + 2 &&
+    type_string[0] == '(' &&
+    strncmp (type_string + 1, signature, len) == 0 &&
+    type_string[len + 1] == ')';
+}
+
+/**
+ * _g_dbus_method_info_check_in_signature:
+ * @method_info: A #GDBusMethodInfo.
+ * @in_type_info: The interned in tuple type of @method_info or %NULL.
+ * @signature: The D-Bus signature of an incoming method call.
+ *
+ * Checks whether @signature is the in signature of @method_info, so
+ * a message can be rejected before converting its body. If
+ * @in_type_info is set, the comparison is against its type string
+ * without the enclosing parentheses.
+ *
+ * Returns: %TRUE if @signature matches.
+ */
+gboolean
+_g_dbus_method_info_check_in_signature (const GDBusMethodInfo *method_info,
+                                        GVariantTypeInfo      *in_type_info,
+                                        const gchar           *signature)
+{
+  const gchar *type_string;
+  gsize len;
+
+  if (signature == NULL)
+    signature = "";
+
+  if (in_type_info == NULL)
+    return g_strcmp0 (method_info->in_signature != NULL ? method_info->in_signature : "", signature) == 0;
+
+  type_string = g_variant_type_info_get_type_string (in_type_info);
+  len = strlen (signature);
+
+  return strncmp (type_string + 1, signature, len) == 0 &&
+    type_string[len + 1] == ')' &&
+    type_string[len + 2] == '\0';
+}
+
+/**
+ * _g_dbus_method_info_check_out_type:
+ * @method_info: A #GDBusMethodInfo.
+ * @out_type_info: The interned out tuple type of @method_info or %NULL.
+ * @parameters: A #GVariant tuple.
+ *
+ * Checks whether @parameters matches the out signature of
+ * @method_info. If @out_type_info is set, this is a pointer
+ * comparison since type info is unique per type string.
+ *
+ * Returns: %TRUE if the type of @parameters is the out signature in a tuple.
+ */
+gboolean
+_g_dbus_method_info_check_out_type (const GDBusMethodInfo *method_info,
+                                    GVariantTypeInfo      *out_type_info,
+                                    GVariant              *parameters)
+{
+  const GVariantType *type;
+
+  type = g_variant_get_type (parameters);
+  if (out_type_info != NULL)
+    return (const gchar *) type == g_variant_type_info_get_type_string (out_type_info);
+
+  return type_is_tuple_of_signature (type, method_info->out_signature);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
 /**
  * g_dbus_interface_info_lookup_method:
  * @interface_info: A #GDBusInterfaceInfo.
@@ -1686,7 +2106,8 @@ g_dbus_annotation_info_lookup (const GDBusAnnotationInfo *annotations,
  *
  * Looks up information about a method.
  *
- * This cost of this function is O(n) in number of methods.
+ * This cost of this function is O(n) in number of methods unless
+ * g_dbus_interface_info_cache_build() has been used on @interface_info.
  *
  * Returns: A #GDBusMethodInfo or %NULL if not found. Do not free, it is owned by @interface_info.
  **/
@@ -1697,6 +2118,12 @@ g_dbus_interface_info_lookup_method (const GDBusInterfaceInfo *interface_info,
   guint n;
   const GDBusMethodInfo *result;
 
+  if (info_cache_lookup (interface_info,
+                         G_STRUCT_OFFSET (GDBusInterfaceInfoIndex, method_name_to_data),
+                         name,
+                         (gconstpointer *) &result))
+    goto out;
+
   for (n = 0; n < interface_info->num_methods; n++)
     {
       const GDBusMethodInfo *i = interface_info->methods + n;
@@ -1723,7 +2150,8 @@ g_dbus_interface_info_lookup_method (const GDBusInterfaceInfo *interface_info,
  *
  * Looks up information about a signal.
  *
- * This cost of this function is O(n) in number of signals.
+ * This cost of this function is O(n) in number of signals unless
+ * g_dbus_interface_info_cache_build() has been used on @interface_info.
  *
  * Returns: A #GDBusSignalInfo or %NULL if not found. Do not free, it is owned by @interface_info.
  **/
@@ -1734,6 +2162,12 @@ g_dbus_interface_info_lookup_signal (const GDBusInterfaceInfo *interface_info,
   guint n;
   const GDBusSignalInfo *result;
 
+  if (info_cache_lookup (interface_info,
+                         G_STRUCT_OFFSET (GDBusInterfaceInfoIndex, signal_name_to_data),
+                         name,
+                         (gconstpointer *) &result))
+    goto out;
+
   for (n = 0; n < interface_info->num_signals; n++)
     {
       const GDBusSignalInfo *i = interface_info->signals + n;
@@ -1760,7 +2194,8 @@ g_dbus_interface_info_lookup_signal (const GDBusInterfaceInfo *interface_info,
  *
  * Looks up information about a property.
  *
- * This cost of this function is O(n) in number of properties.
+ * This cost of this function is O(n) in number of properties unless
+ * g_dbus_interface_info_cache_build() has been used on @interface_info.
  *
  * Returns: A #GDBusPropertyInfo or %NULL if not found. Do not free, it is owned by @interface_info.
  **/
@@ -1771,6 +2206,12 @@ g_dbus_interface_info_lookup_property (const GDBusInterfaceInfo *interface_info,
   guint n;
   const GDBusPropertyInfo *result;
 
+  if (info_cache_lookup (interface_info,
+                         G_STRUCT_OFFSET (GDBusInterfaceInfoIndex, property_name_to_data),
+                         name,
+                         (gconstpointer *) &result))
+    goto out;
+
   for (n = 0; n < interface_info->num_properties; n++)
     {
       const GDBusPropertyInfo *i = interface_info->properties + n;
@@ -194,6 +194,8 @@ const GDBusPropertyInfo  *g_dbus_interface_info_lookup_property  (const GDBusInt
 void                      g_dbus_interface_info_generate_xml     (const GDBusInterfaceInfo  *interface_info,
                                                                   guint                      indent,
                                                                   GString                   *string_builder);
+void                      g_dbus_interface_info_cache_build      (const GDBusInterfaceInfo  *interface_info);
+void                      g_dbus_interface_info_cache_release    (const GDBusInterfaceInfo  *interface_info);
 
 GDBusNodeInfo            *g_dbus_node_info_new_for_xml           (const gchar               *xml_data,
                                                                   GError                   **error);
@@ -45,13 +45,21 @@
 struct _GDBusMethodInvocationPrivate
 {
   /* construct-only properties */
-  gchar           *sender;
-  gchar           *object_path;
-  gchar           *interface_name;
-  gchar           *method_name;
+  const gchar     *sender;
+  const gchar     *object_path;
+  const gchar     *interface_name;
+  const gchar     *method_name;
   GDBusConnection *connection;
   GVariant        *parameters;
   gpointer         user_data;
+
+  /* Only set for invocations created by _g_dbus_method_invocation_new(); if
+   * set, the strings above are owned by @message rather than by us
+   */
+  DBusMessage                *message;
+  const GDBusInterfaceVTable *vtable;
+  const GDBusMethodInfo      *method_info;
+  GVariantTypeInfo           *out_type_info; /* interned out tuple type of method_info, may be NULL */
 };
 
 enum
@@ -73,12 +81,21 @@ g_dbus_method_invocation_finalize (GObject *object)
 {
   GDBusMethodInvocation *invocation = G_DBUS_METHOD_INVOCATION (object);
 
-  g_free (invocation->priv->sender);
-  g_free (invocation->priv->object_path);
-  g_free (invocation->priv->interface_name);
-  g_free (invocation->priv->method_name);
+  if (invocation->priv->message != NULL)
+    {
+      dbus_message_unref (invocation->priv->message);
+    }
+  else
+    {
+      g_free ((gpointer) invocation->priv->sender);
+      g_free ((gpointer) invocation->priv->object_path);
+      g_free ((gpointer) invocation->priv->interface_name);
+      g_free ((gpointer) invocation->priv->method_name);
+    }
   g_object_unref (invocation->priv->connection);
   g_variant_unref (invocation->priv->parameters);
+  if (invocation->priv->out_type_info != NULL)
+    g_variant_type_info_unref (invocation->priv->out_type_info);
 
   if (G_OBJECT_CLASS (g_dbus_method_invocation_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (g_dbus_method_invocation_parent_class)->finalize (object);
@@ -465,6 +482,50 @@ g_dbus_method_invocation_new (const gchar      *sender,
                                                  NULL));
 }
 
+/* Creates a #GDBusMethodInvocation for an incoming method call without
+ * going through the GObject property machinery - g_object_new() only sets
+ * the construct-only properties to their NULL defaults, and the private
+ * fields are filled in afterwards. The strings are borrowed from @message
+ * which is kept alive for the lifetime of the invocation.
+ */
+GDBusMethodInvocation *
+_g_dbus_method_invocation_new (DBusMessage                *message,
+                               GDBusConnection            *connection,
+                               GVariant                   *parameters,
+                               const GDBusInterfaceVTable *vtable,
+                               const GDBusMethodInfo      *method_info,
+                               GVariantTypeInfo           *out_type_info,
+                               gpointer                    user_data)
+{
+  GDBusMethodInvocation *invocation;
+  GDBusMethodInvocationPrivate *priv;
+
+  invocation = G_DBUS_METHOD_INVOCATION (g_object_new (G_TYPE_DBUS_METHOD_INVOCATION, NULL));
+  priv = invocation->priv;
+
+  priv->message = dbus_message_ref (message);
+  priv->sender = dbus_message_get_sender (message);
+  priv->object_path = dbus_message_get_path (message);
+  priv->interface_name = dbus_message_get_interface (message);
+  priv->method_name = dbus_message_get_member (message);
+  priv->connection = g_object_ref (connection);
+  priv->parameters = g_variant_ref (parameters);
+  priv->user_data = user_data;
+  priv->vtable = vtable;
+  priv->method_info = method_info;
+  if (out_type_info != NULL)
+    priv->out_type_info = g_variant_type_info_ref (out_type_info);
+
+  return invocation;
+}
+
+/* Gets the vtable passed to _g_dbus_method_invocation_new() */
+const GDBusInterfaceVTable *
+_g_dbus_method_invocation_get_vtable (GDBusMethodInvocation *invocation)
+{
+  return invocation->priv->vtable;
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 /**
@@ -476,6 +537,9 @@ g_dbus_method_invocation_new (const gchar      *sender,
  *
  * It is an error if @parameters is not of the right format.
  *
+ * If the caller set the <literal>NO_REPLY_EXPECTED</literal> flag on
+ * the method call, nothing is sent.
+ *
  * This method will free @invocation, you cannot use it afterwards.
  */
 void
@@ -483,21 +547,21 @@ g_dbus_method_invocation_return_value (GDBusMethodInvocation *invocation,
                                        GVariant              *parameters)
 {
   DBusMessage *message;
-  GDBusMethodInfo *method_info;
+  const GDBusMethodInfo *method_info;
   DBusMessage *reply;
   GError *error;
 
   g_return_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation));
   g_return_if_fail ((parameters == NULL) || (g_variant_get_type_class (parameters) == G_VARIANT_CLASS_TUPLE));
 
-  message = g_object_get_data (G_OBJECT (invocation), "dbus-1-message");
+  message = invocation->priv->message;
   g_assert (message != NULL);
 
   if (parameters != NULL)
     g_variant_ref_sink (parameters);
 
   /* if we have introspection data, check that the signature of @parameters is correct */
-  method_info = g_object_get_data (G_OBJECT (invocation), "g-dbus-method-info");
+  method_info = invocation->priv->method_info;
   if (method_info != NULL)
     {
       gboolean pass;
@@ -510,15 +574,10 @@ g_dbus_method_invocation_return_value (GDBusMethodInvocation *invocation,
         }
       else
         {
-          const gchar *type_string;
-          gchar *sig_with_paren;
-
-          /* this can probably be done a lot more efficiently */
-          sig_with_paren = g_strdup_printf ("(%s)", method_info->out_signature);
-          type_string = g_variant_get_type_string (parameters);
-          if (g_strcmp0 (sig_with_paren, type_string) == 0)
-            pass = TRUE;
-          g_free (sig_with_paren);
+          /* a pointer comparison if the object was exported with g_dbus_connection_register_object() */
+          pass = _g_dbus_method_info_check_out_type (method_info,
+                                                     invocation->priv->out_type_info,
+                                                     parameters);
         }
 
       if (!pass)
@@ -529,6 +588,10 @@ g_dbus_method_invocation_return_value (GDBusMethodInvocation *invocation,
         }
     }
 
+  /* the caller told us it isn't interested in the reply, so don't bother building it */
+  if (dbus_message_get_no_reply (message))
+    goto out;
+
   reply = dbus_message_new_method_return (message);
   error = NULL;
   if (parameters != NULL)
@@ -576,6 +639,9 @@ g_dbus_method_invocation_return_value (GDBusMethodInvocation *invocation,
  * <emphasis>always</emphasis> register errors with g_dbus_error_register_error()
  * or use g_dbus_method_invocation_return_dbus_error().
  *
+ * As with g_dbus_method_invocation_return_value(), nothing is sent if
+ * the caller set the <literal>NO_REPLY_EXPECTED</literal> flag.
+ *
  * This method will free @invocation, you cannot use it afterwards.
  */
 void
@@ -624,6 +690,12 @@ g_dbus_method_invocation_return_error_valist (GDBusMethodInvocation *invocation,
   g_return_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation));
   g_return_if_fail (format != NULL);
 
+  if (dbus_message_get_no_reply (invocation->priv->message))
+    {
+      g_object_unref (invocation);
+      return;
+    }
+
   literal_message = g_strdup_vprintf (format, var_args);
   g_dbus_method_invocation_return_error_literal (invocation,
                                                  domain,
@@ -678,6 +750,12 @@ g_dbus_method_invocation_return_gerror (GDBusMethodInvocation *invocation,
   g_return_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation));
   g_return_if_fail (error != NULL);
 
+  if (dbus_message_get_no_reply (invocation->priv->message))
+    {
+      g_object_unref (invocation);
+      return;
+    }
+
   dbus_error_name = g_dbus_error_encode_gerror (error);
 
   g_dbus_method_invocation_return_dbus_error (invocation,
@@ -708,14 +786,18 @@ g_dbus_method_invocation_return_dbus_error (GDBusMethodInvocation *invocation,
   g_return_if_fail (error_name != NULL);
   g_return_if_fail (error_message != NULL);
 
-  message = g_object_get_data (G_OBJECT (invocation), "dbus-1-message");
+  message = invocation->priv->message;
   g_assert (message != NULL);
 
+  if (dbus_message_get_no_reply (message))
+    goto out;
+
   reply = dbus_message_new_error (message,
                                   error_name,
                                   error_message);
   _g_dbus_connection_send_dbus_1_message (g_dbus_method_invocation_get_connection (invocation), reply);
   dbus_message_unref (reply);
 
+ out:
   g_object_unref (invocation);
 }
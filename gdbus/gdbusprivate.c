@@ -55,10 +55,16 @@ _g_dbus_oom (void)
  * (at your option) any later version.
  */
 
+/* Default limits for how much work message_queue_dispatch() does per main loop iteration */
+#define DEFAULT_DISPATCH_MAX_MESSAGES 64
+#define DEFAULT_DISPATCH_MAX_USEC     5000
+
 typedef struct
 {
   GSource source; /**< the parent GSource */
   DBusConnection *connection; /**< the connection to dispatch */
+  guint max_messages; /**< max number of messages to dispatch per iteration, 0 for default */
+  guint max_usec; /**< max time to spend dispatching per iteration, 0 for default */
 } DBusGMessageQueue;
 
 static gboolean message_queue_prepare  (GSource     *source,
@@ -97,23 +103,107 @@ message_queue_dispatch (GSource     *source,
                         GSourceFunc  callback,
                         gpointer     user_data)
 {
-  DBusConnection *connection = ((DBusGMessageQueue *)source)->connection;
+  DBusGMessageQueue *queue = (DBusGMessageQueue *) source;
+  DBusConnection *connection = queue->connection;
+  guint max_messages;
+  glong max_usec;
+  GTimeVal start;
+  GTimeVal now;
+  guint n;
+
+  max_messages = queue->max_messages > 0 ? queue->max_messages : DEFAULT_DISPATCH_MAX_MESSAGES;
+  max_usec = queue->max_usec > 0 ? queue->max_usec : DEFAULT_DISPATCH_MAX_USEC;
 
   dbus_connection_ref (connection);
 
-  /* Only dispatch once - we don't want to starve other GSource */
-  dbus_connection_dispatch (connection);
+  /* Dispatch a bounded batch - we don't want to starve other GSource but
+   * we also don't want to pay for a main loop iteration per message when
+   * a burst of messages arrives
+   */
+  g_get_current_time (&start);
+  for (n = 0; n < max_messages; n++)
+    {
+      if (dbus_connection_dispatch (connection) != DBUS_DISPATCH_DATA_REMAINS)
+        break;
+
+      g_get_current_time (&now);
+      if ((now.tv_sec - start.tv_sec) * G_USEC_PER_SEC + (now.tv_usec - start.tv_usec) >= max_usec)
+        break;
+    }
 
   dbus_connection_unref (connection);
 
   return TRUE;
 }
 
+/* A GSource polling a single fd - this avoids creating a GIOChannel per DBusWatch */
+
+typedef gboolean (*FdWatchFunc) (GIOCondition condition,
+                                 gpointer     user_data);
+
+typedef struct
+{
+  GSource source; /**< the parent GSource */
+  GPollFD pollfd; /**< the fd being polled */
+} FdWatchSource;
+
+static gboolean
+fd_watch_prepare (GSource *source,
+                  gint    *timeout)
+{
+  *timeout = -1;
+  return FALSE;
+}
+
+static gboolean
+fd_watch_check (GSource *source)
+{
+  FdWatchSource *watch_source = (FdWatchSource *) source;
+
+  return (watch_source->pollfd.revents & watch_source->pollfd.events) != 0;
+}
+
+static gboolean
+fd_watch_dispatch (GSource     *source,
+                   GSourceFunc  callback,
+                   gpointer     user_data)
+{
+  FdWatchSource *watch_source = (FdWatchSource *) source;
+
+  if (callback == NULL)
+    return FALSE;
+
+  return ((FdWatchFunc) callback) (watch_source->pollfd.revents & watch_source->pollfd.events,
+                                   user_data);
+}
+
+static const GSourceFuncs fd_watch_funcs = {
+  fd_watch_prepare,
+  fd_watch_check,
+  fd_watch_dispatch,
+  NULL
+};
+
+static GSource *
+fd_watch_source_new (gint         fd,
+                     GIOCondition condition)
+{
+  FdWatchSource *watch_source;
+
+  watch_source = (FdWatchSource *) g_source_new ((GSourceFuncs *) &fd_watch_funcs,
+                                                 sizeof (FdWatchSource));
+  watch_source->pollfd.fd = fd;
+  watch_source->pollfd.events = condition;
+  g_source_add_poll ((GSource *) watch_source, &watch_source->pollfd);
+
+  return (GSource *) watch_source;
+}
+
 typedef struct
 {
   GMainContext *context;      /**< the main context */
-  GSList *ios;                /**< all IOHandler */
-  GSList *timeouts;           /**< all TimeoutHandler */
+  GQueue ios;                 /**< all IOHandler */
+  GQueue timeouts;            /**< all TimeoutHandler */
   DBusConnection *connection; /**< NULL if this is really for a server not a connection */
   GSource *message_queue_source; /**< DBusGMessageQueue */
 } ConnectionSetup;
@@ -124,6 +214,7 @@ typedef struct
   ConnectionSetup *cs;
   GSource *source;
   DBusWatch *watch;
+  GList *link; /**< our link in cs->ios */
 } IOHandler;
 
 typedef struct
@@ -131,6 +222,7 @@ typedef struct
   ConnectionSetup *cs;
   GSource *source;
   DBusTimeout *timeout;
+  GList *link; /**< our link in cs->timeouts */
 } TimeoutHandler;
 
 G_LOCK_DEFINE_STATIC (main_loop_lock);
@@ -188,7 +280,8 @@ io_handler_destroy_source (void *data)
     {
       GSource *source = handler->source;
       handler->source = NULL;
-      handler->cs->ios = g_slist_remove (handler->cs->ios, handler);
+      g_queue_delete_link (&handler->cs->ios, handler->link);
+      handler->link = NULL;
       g_source_destroy (source);
       g_source_unref (source);
     }
@@ -207,8 +300,7 @@ io_handler_watch_freed (void *data)
 }
 
 static gboolean
-io_handler_dispatch (GIOChannel   *source,
-                     GIOCondition  condition,
+io_handler_dispatch (GIOCondition  condition,
                      gpointer      data)
 {
   IOHandler *handler;
@@ -250,7 +342,6 @@ connection_setup_add_watch (ConnectionSetup *cs,
 {
   guint flags;
   GIOCondition condition;
-  GIOChannel *channel;
   IOHandler *handler;
 
   if (!dbus_watch_get_enabled (watch))
@@ -270,17 +361,15 @@ connection_setup_add_watch (ConnectionSetup *cs,
   handler->cs = cs;
   handler->watch = watch;
 
-  channel = g_io_channel_unix_new (dbus_watch_get_unix_fd (watch));
-
-  handler->source = g_io_create_watch (channel, condition);
+  handler->source = fd_watch_source_new (dbus_watch_get_unix_fd (watch), condition);
   g_source_set_callback (handler->source, (GSourceFunc) io_handler_dispatch, handler,
                          io_handler_source_finalized);
   g_source_attach (handler->source, cs->context);
 
-  cs->ios = g_slist_prepend (cs->ios, handler);
+  g_queue_push_head (&cs->ios, handler);
+  handler->link = cs->ios.head;
 
   dbus_watch_set_data (watch, handler, io_handler_watch_freed);
-  g_io_channel_unref (channel);
 }
 
 static void
@@ -321,7 +410,8 @@ timeout_handler_destroy_source (void *data)
     {
       GSource *source = handler->source;
       handler->source = NULL;
-      handler->cs->timeouts = g_slist_remove (handler->cs->timeouts, handler);
+      g_queue_delete_link (&handler->cs->timeouts, handler->link);
+      handler->link = NULL;
       g_source_destroy (source);
       g_source_unref (source);
     }
@@ -371,7 +461,8 @@ connection_setup_add_timeout (ConnectionSetup *cs,
                          timeout_handler_source_finalized);
   g_source_attach (handler->source, handler->cs->context);
 
-  cs->timeouts = g_slist_prepend (cs->timeouts, handler);
+  g_queue_push_head (&cs->timeouts, handler);
+  handler->link = cs->timeouts.head;
 
   dbus_timeout_set_data (timeout, handler, timeout_handler_timeout_freed);
 }
@@ -393,11 +484,11 @@ connection_setup_remove_timeout (ConnectionSetup *cs,
 static void
 connection_setup_free (ConnectionSetup *cs)
 {
-  while (cs->ios)
-    io_handler_destroy_source (cs->ios->data);
+  while (cs->ios.head != NULL)
+    io_handler_destroy_source (cs->ios.head->data);
 
-  while (cs->timeouts)
-    timeout_handler_destroy_source (cs->timeouts->data);
+  while (cs->timeouts.head != NULL)
+    timeout_handler_destroy_source (cs->timeouts.head->data);
 
   if (cs->message_queue_source)
     {
@@ -505,14 +596,23 @@ static ConnectionSetup*
 connection_setup_new_from_old (GMainContext    *context,
                                ConnectionSetup *old)
 {
-  GSList *tmp;
+  GList *tmp;
   ConnectionSetup *cs;
 
   g_assert (old->context != context);
 
   cs = connection_setup_new (context, old->connection);
 
-  tmp = old->ios;
+  if (old->message_queue_source != NULL)
+    {
+      DBusGMessageQueue *old_queue = (DBusGMessageQueue *) old->message_queue_source;
+      DBusGMessageQueue *queue = (DBusGMessageQueue *) cs->message_queue_source;
+
+      queue->max_messages = old_queue->max_messages;
+      queue->max_usec = old_queue->max_usec;
+    }
+
+  tmp = old->ios.head;
   while (tmp != NULL)
     {
       IOHandler *handler = tmp->data;
@@ -522,7 +622,7 @@ connection_setup_new_from_old (GMainContext    *context,
       tmp = tmp->next;
     }
 
-  tmp = old->timeouts;
+  tmp = old->timeouts.head;
   while (tmp != NULL)
     {
       TimeoutHandler *handler = tmp->data;
@@ -632,6 +732,58 @@ _g_dbus_integrate_dbus_1_connection (DBusConnection *connection,
   _g_dbus_oom ();
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gpointer
+io_worker_thread_func (gpointer user_data)
+{
+  GMainContext *context = user_data;
+  GMainLoop *loop;
+
+  g_main_context_push_thread_default (context);
+  loop = g_main_loop_new (context, FALSE);
+  g_main_loop_run (loop);
+
+  /* never reached - the thread lives as long as the process */
+  g_main_loop_unref (loop);
+  g_main_context_pop_thread_default (context);
+
+  return NULL;
+}
+
+static gpointer
+io_worker_thread_start (gpointer data)
+{
+  GMainContext *context;
+  GError *error;
+
+  context = g_main_context_new ();
+
+  error = NULL;
+  if (g_thread_create (io_worker_thread_func, context, FALSE, &error) == NULL)
+    g_error ("Error creating the D-Bus I/O thread: %s", error->message);
+
+  return context;
+}
+
+/**
+ * _g_dbus_get_io_worker_context:
+ *
+ * Gets the #GMainContext of the worker thread used for connections
+ * doing I/O off the main loop, starting the thread if needed.
+ *
+ * Returns: A #GMainContext. Do not free, it is owned by the worker thread.
+ */
+GMainContext *
+_g_dbus_get_io_worker_context (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, io_worker_thread_start, NULL);
+
+  return once.retval;
+}
+
 /**
  * _g_dbus_unintegrate_dbus_1_connection:
  * @connection: A #DBusConnection.
@@ -671,6 +823,34 @@ _g_dbus_unintegrate_dbus_1_connection (DBusConnection *connection)
   _g_dbus_oom ();
 }
 
+/**
+ * _g_dbus_set_dbus_1_connection_dispatch_budget:
+ * @connection: A #DBusConnection integrated with _g_dbus_integrate_dbus_1_connection().
+ * @max_messages: Maximum number of messages to dispatch per main loop iteration or 0 for the default.
+ * @max_usec: Maximum time in microseconds to spend dispatching per main loop iteration or 0 for the default.
+ *
+ * Sets how many queued messages are dispatched per iteration of the
+ * main loop @connection is integrated with.
+ */
+void
+_g_dbus_set_dbus_1_connection_dispatch_budget (DBusConnection *connection,
+                                               guint           max_messages,
+                                               guint           max_usec)
+{
+  ConnectionSetup *cs;
+  DBusGMessageQueue *queue;
+
+  ensure_slots ();
+
+  cs = dbus_connection_get_data (connection, _dbus_gmain_connection_slot);
+  if (cs == NULL || cs->message_queue_source == NULL)
+    return;
+
+  queue = (DBusGMessageQueue *) cs->message_queue_source;
+  queue->max_messages = max_messages;
+  queue->max_usec = max_usec;
+}
+
 /**
  * _g_dbus_integrate_dbus_1_server:
  * @server: A #DBusServer.
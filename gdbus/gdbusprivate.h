@@ -30,6 +30,8 @@
 #include <gdbus/gdbustypes.h>
 #include <dbus/dbus.h>
 
+#include "gvarianttypeinfo.h"
+
 G_BEGIN_DECLS
 
 void _g_dbus_oom (void);
@@ -37,6 +39,11 @@ void _g_dbus_oom (void);
 void _g_dbus_integrate_dbus_1_connection   (DBusConnection *connection,
                                             GMainContext   *context);
 void _g_dbus_unintegrate_dbus_1_connection (DBusConnection *connection);
+GMainContext *_g_dbus_get_io_worker_context (void);
+
+void _g_dbus_set_dbus_1_connection_dispatch_budget (DBusConnection *connection,
+                                                    guint           max_messages,
+                                                    guint           max_usec);
 
 void _g_dbus_integrate_dbus_1_server       (DBusServer   *server,
                                             GMainContext *context);
@@ -47,6 +54,42 @@ void _g_dbus_connection_send_dbus_1_message (GDBusConnection    *connection,
 
 GDBusConnection *_g_dbus_connection_new_for_dbus_1_connection (DBusConnection *dbus_1_connection);
 
+/* only for the test suite, which links the library statically to get at it */
+void _g_dbus_connection_get_match_rule_stats (GDBusConnection *connection,
+                                              guint           *out_num_add_match,
+                                              guint           *out_num_remove_match);
+
+GDBusMethodInvocation      *_g_dbus_method_invocation_new        (DBusMessage                *message,
+                                                                  GDBusConnection            *connection,
+                                                                  GVariant                   *parameters,
+                                                                  const GDBusInterfaceVTable *vtable,
+                                                                  const GDBusMethodInfo      *method_info,
+                                                                  GVariantTypeInfo           *out_type_info,
+                                                                  gpointer                    user_data);
+const GDBusInterfaceVTable *_g_dbus_method_invocation_get_vtable (GDBusMethodInvocation      *invocation);
+
+typedef struct _GDBusInterfaceInfoIndex GDBusInterfaceInfoIndex;
+
+GDBusInterfaceInfoIndex  *_g_dbus_interface_info_index_new             (const GDBusInterfaceInfo      *interface_info);
+void                      _g_dbus_interface_info_index_free            (GDBusInterfaceInfoIndex       *index);
+const GDBusMethodInfo    *_g_dbus_interface_info_index_lookup_method   (const GDBusInterfaceInfoIndex *index,
+                                                                        const gchar                   *name);
+const GDBusSignalInfo    *_g_dbus_interface_info_index_lookup_signal   (const GDBusInterfaceInfoIndex *index,
+                                                                        const gchar                   *name);
+const GDBusPropertyInfo  *_g_dbus_interface_info_index_lookup_property (const GDBusInterfaceInfoIndex *index,
+                                                                        const gchar                   *name);
+void                      _g_dbus_interface_info_index_get_method_types (const GDBusInterfaceInfoIndex  *index,
+                                                                         const GDBusMethodInfo          *method_info,
+                                                                         GVariantTypeInfo              **out_in_type_info,
+                                                                         GVariantTypeInfo              **out_out_type_info);
+
+gboolean _g_dbus_method_info_check_in_signature (const GDBusMethodInfo *method_info,
+                                                 GVariantTypeInfo      *in_type_info,
+                                                 const gchar           *signature);
+gboolean _g_dbus_method_info_check_out_type     (const GDBusMethodInfo *method_info,
+                                                 GVariantTypeInfo      *out_type_info,
+                                                 GVariant              *parameters);
+
 G_END_DECLS
 
 #endif /* __G_DBUS_PRIVATE_H__ */
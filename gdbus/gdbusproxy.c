@@ -1190,10 +1190,13 @@ g_dbus_proxy_invoke_method (GDBusProxy          *proxy,
   g_return_if_fail (G_IS_DBUS_PROXY (proxy));
   g_return_if_fail (method_name != NULL);
 
-  simple = g_simple_async_result_new (G_OBJECT (proxy),
-                                      callback,
-                                      user_data,
-                                      g_dbus_proxy_invoke_method);
+  /* no need to track the call if the caller doesn't care about the reply */
+  simple = NULL;
+  if (callback != NULL)
+    simple = g_simple_async_result_new (G_OBJECT (proxy),
+                                        callback,
+                                        user_data,
+                                        g_dbus_proxy_invoke_method);
 
   was_split = maybe_split_method_name (method_name, &split_interface_name, &split_method_name);
 
@@ -1205,7 +1208,7 @@ g_dbus_proxy_invoke_method (GDBusProxy          *proxy,
                                    parameters,
                                    timeout_msec == -1 ? proxy->priv->timeout_msec : timeout_msec,
                                    cancellable,
-                                   (GAsyncReadyCallback) reply_cb,
+                                   simple != NULL ? (GAsyncReadyCallback) reply_cb : NULL,
                                    simple);
 
   g_free (split_interface_name);
@@ -36,6 +36,7 @@ typedef struct _GDBusConnection       GDBusConnection;
 typedef struct _GDBusServer           GDBusServer;
 typedef struct _GDBusProxy            GDBusProxy;
 typedef struct _GDBusMethodInvocation GDBusMethodInvocation;
+typedef struct _GDBusMethodCallBatch  GDBusMethodCallBatch;
 
 typedef struct _GDBusInterfaceVTable  GDBusInterfaceVTable;
 typedef struct _GDBusSubtreeVTable    GDBusSubtreeVTable;
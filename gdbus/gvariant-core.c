@@ -89,7 +89,6 @@ struct _GVariant
 
   gsize size;
   GVariantTypeInfo *type;
-  gboolean floating;
   gint state;
   gint ref_count;
 };
@@ -112,8 +111,19 @@ struct _GVariant
 #define CONDITION_RECONSTRUCTED         0x00004000
 
 #define CONDITION_NOTIFY                0x00010000
+#define CONDITION_FLOATING              0x40000000
 #define CONDITION_LOCKED                0x80000000
 
+/* A serialised instance that is native and trusted is settled: none of
+ * the conditions that change its contents can be enabled anymore (both
+ * 'independent' and 'reconstructed' are forbidden by 'native') so apart
+ * from the 'fixed-size' and 'floating' flags its state never changes
+ * again.  Queries on settled instances need neither the lock nor a
+ * write to the state word.
+ */
+#define CONDITION_SETTLED               (CONDITION_SERIALISED | CONDITION_SIZE_VALID | \
+                                         CONDITION_NATIVE | CONDITION_TRUSTED)
+
 static const char * /* debugging only */
 g_variant_state_to_string (guint state)
 {
@@ -135,6 +145,7 @@ g_variant_state_to_string (guint state)
   add (CONDITION_SERIALISED,     "serialised");
   add (CONDITION_RECONSTRUCTED,  "reconstructed");
   add (CONDITION_NOTIFY,         "notify");
+  add (CONDITION_FLOATING,       "floating");
 #undef add
 
   g_string_truncate (string, string->len - 2);
@@ -142,17 +153,82 @@ g_variant_state_to_string (guint state)
 }
 
 /* == SECTION 2: allocation/free functions =============================== */
+/* Decoding a message creates and frees lots of short-lived instances,
+ * so each thread keeps the headers of up to INSTANCE_POOL_MAX_FREE freed
+ * instances on a free list (linked through contents.serialised.source)
+ * and hands them out again instead of going through g_slice.
+ */
+#define INSTANCE_POOL_MAX_FREE 64
+
+typedef struct
+{
+  GVariant *free_list;
+  guint n_free;
+
+  /* statistics for the test cases */
+  guint n_slice_allocs;
+  guint n_reused;
+} InstancePool;
+
+static GStaticPrivate g_variant_instance_pool = G_STATIC_PRIVATE_INIT;
+
+static void
+g_variant_instance_pool_free (gpointer data)
+{
+  InstancePool *pool = data;
+
+  while (pool->free_list != NULL)
+    {
+      GVariant *value;
+
+      value = pool->free_list;
+      pool->free_list = value->contents.serialised.source;
+      g_slice_free (GVariant, value);
+    }
+
+  g_slice_free (InstancePool, pool);
+}
+
+static InstancePool *
+g_variant_instance_pool_get (void)
+{
+  InstancePool *pool;
+
+  pool = g_static_private_get (&g_variant_instance_pool);
+  if G_UNLIKELY (pool == NULL)
+    {
+      pool = g_slice_new0 (InstancePool);
+      g_static_private_set (&g_variant_instance_pool, pool,
+                            g_variant_instance_pool_free);
+    }
+
+  return pool;
+}
+
 static GVariant *
 g_variant_alloc (GVariantTypeInfo *type,
                  guint             initial_state)
 {
+  InstancePool *pool;
   GVariant *new;
 
-  new = g_slice_new (GVariant);
+  pool = g_variant_instance_pool_get ();
+  if (pool->free_list != NULL)
+    {
+      new = pool->free_list;
+      pool->free_list = new->contents.serialised.source;
+      pool->n_free--;
+      pool->n_reused++;
+    }
+  else
+    {
+      new = g_slice_new (GVariant);
+      pool->n_slice_allocs++;
+    }
+
   new->ref_count = 1;
   new->type = type;
-  new->floating = TRUE;
-  new->state = initial_state & ~CONDITION_LOCKED;
+  new->state = (initial_state & ~CONDITION_LOCKED) | CONDITION_FLOATING;
 
   return new;
 }
@@ -160,6 +236,8 @@ g_variant_alloc (GVariantTypeInfo *type,
 static void
 g_variant_free (GVariant *value)
 {
+  InstancePool *pool;
+
   /* free the type info */
   if (value->type)
     g_variant_type_info_unref (value->type);
@@ -192,8 +270,18 @@ g_variant_free (GVariant *value)
       g_slice_free1 (sizeof (GVariant *) * n_children, children);
     }
 
-  /* free the structure itself */
-  g_slice_free (GVariant, value);
+  /* free the structure itself, or keep it for reuse.  the pool is not
+   * created here so nothing is set up again while the thread exits.
+   */
+  pool = g_static_private_get (&g_variant_instance_pool);
+  if (pool != NULL && pool->n_free < INSTANCE_POOL_MAX_FREE)
+    {
+      value->contents.serialised.source = pool->free_list;
+      pool->free_list = value;
+      pool->n_free++;
+    }
+  else
+    g_slice_free (GVariant, value);
 }
 
 static void
@@ -208,6 +296,30 @@ g_variant_unlock (GVariant *value)
   g_bit_unlock (&value->state, 31);
 }
 
+/* Clears the floating flag, returning %TRUE if it was set.
+ *
+ * The other condition bits are only ever modified with the lock held
+ * (or before the instance is shared), so the flag is only cleared while
+ * the lock is not held; otherwise a non-atomic update by the lock
+ * holder could be lost.
+ */
+static gboolean
+g_variant_clear_floating (GVariant *value)
+{
+  guint state;
+
+  do
+    {
+      state = g_atomic_int_get (&value->state) & ~CONDITION_LOCKED;
+      if (!(state & CONDITION_FLOATING))
+        return FALSE;
+    }
+  while (!g_atomic_int_compare_and_exchange (&value->state, state,
+                                             state & ~CONDITION_FLOATING));
+
+  return TRUE;
+}
+
 /* == SECTION 3: condition enabling functions ============================ */
 static void g_variant_fill_gvs (GVariantSerialised *, gpointer);
 
@@ -523,9 +635,25 @@ g_variant_state_is_valid (guint state)
 void
 g_variant_assert_invariant (GVariant *value)
 {
-  if (value->state & CONDITION_NOTIFY)
+  guint state;
+
+  state = g_atomic_int_get (&value->state);
+
+  if (state & CONDITION_NOTIFY)
     return;
 
+  /* the state of settled instances can be checked without the lock */
+  if ((state & CONDITION_SETTLED) == CONDITION_SETTLED)
+    {
+      g_assert_cmpint (g_atomic_int_get (&value->ref_count), >, 0);
+
+      if G_UNLIKELY (!g_variant_state_is_valid (state & ~CONDITION_LOCKED))
+        g_critical ("instance %p in invalid state: %s",
+                    value, g_variant_state_to_string (state));
+
+      return;
+    }
+
   g_variant_lock (value);
 
   g_assert_cmpint (value->ref_count, >, 0);
@@ -552,7 +680,7 @@ g_variant_assert_invariant (GVariant *value)
                            value->contents.tree.children[i]->state &
                            CONDITION_TRUSTED);
 
-          g_assert (!value->contents.tree.children[i]->floating);
+          g_assert (!(value->contents.tree.children[i]->state & CONDITION_FLOATING));
           g_variant_assert_invariant (value->contents.tree.children[i]);
         }
     }
@@ -620,7 +748,7 @@ g_variant_try_enabling_conditions (GVariant *value,
 
   g_variant_assert_invariant (value);
 
-  if ((value->state & conditions) == conditions)
+  if ((g_atomic_int_get (&value->state) & conditions) == conditions)
     return TRUE;
 
   g_variant_lock (value);
@@ -707,7 +835,20 @@ g_variant_get_gvs (GVariant  *value,
   g_assert (value->state & CONDITION_SERIALISED);
   g_variant_require_conditions (value, CONDITION_SIZE_VALID);
 
-  if (g_variant_forbid_conditions (value, CONDITION_INDEPENDENT))
+  if ((g_atomic_int_get (&value->state) & CONDITION_SETTLED) == CONDITION_SETTLED)
+    {
+      /* can't become independent anymore, so no need for the lock */
+      gvs.data = value->contents.serialised.data;
+
+      if (source)
+        {
+          if (value->state & CONDITION_INDEPENDENT)
+            *source = g_variant_ref (value);
+          else
+            *source = g_variant_ref (value->contents.serialised.source);
+        }
+    }
+  else if (g_variant_forbid_conditions (value, CONDITION_INDEPENDENT))
     {
       /* dependent */
       gvs.data = value->contents.serialised.data;
@@ -719,13 +860,11 @@ g_variant_get_gvs (GVariant  *value,
     }
   else
     {
-      /* independent */
+      /* independent; g_variant_forbid_conditions() did not keep the lock */
       gvs.data = value->contents.serialised.data;
 
       if (source)
         *source = g_variant_ref (value);
-
-      g_variant_unlock (value);
     }
 
   gvs.size = value->size;
@@ -877,6 +1016,17 @@ g_variant_is_normal_ (GVariant *value)
   return g_variant_serialised_is_normal (g_variant_get_gvs (value, NULL));
 }
 
+void
+g_variant_get_instance_stats_ (guint *n_slice_allocs,
+                               guint *n_reused)
+{
+  InstancePool *pool;
+
+  pool = g_variant_instance_pool_get ();
+  *n_slice_allocs = pool->n_slice_allocs;
+  *n_reused = pool->n_reused;
+}
+
 /* == SECTION 6: user-visibile functions ================================= */
 /**
  * g_variant_get_type:
@@ -990,7 +1140,7 @@ g_variant_get_child_value (GVariant *value,
       child->contents.serialised.source = source;
       child->contents.serialised.data = gvs.data;
       child->size = gvs.size;
-      child->floating = FALSE;
+      child->state &= ~CONDITION_FLOATING;
 
       if (gvs.data == NULL)
         {
@@ -1030,6 +1180,90 @@ g_variant_get_child_value (GVariant *value,
   return child;
 }
 
+/* < private >
+ * g_variant_borrow_child_value:
+ * @value: a container #GVariant
+ * @index: the index of the child to fetch
+ * @storage: storage for the child, typically on the stack
+ * @returns: the child at the specified index
+ *
+ * Like g_variant_get_child_value() but, if @value is serialised and
+ * settled, the child is set up in @storage instead of in a newly
+ * allocated instance and without taking a reference on @value.  The
+ * returned child must only be used while @value is alive and must not
+ * be kept beyond a call to g_variant_release_child_value().
+ *
+ * In any other case this is the same as g_variant_get_child_value().
+ */
+GVariant *
+g_variant_borrow_child_value (GVariant              *value,
+                              gsize                  index,
+                              GVariantChildStorage  *storage)
+{
+  GVariantSerialised gvs;
+  GVariant *child;
+  guint state;
+
+  g_assert (sizeof (GVariant) <= sizeof (GVariantChildStorage));
+  g_variant_assert_invariant (value);
+
+  /* only lend from data that is already serialised and in native byte
+   * order; checking that it is normal (if it's not trusted yet) is done
+   * once and remembered
+   */
+  state = g_atomic_int_get (&value->state);
+  if ((state & (CONDITION_SERIALISED | CONDITION_NATIVE)) !=
+      (CONDITION_SERIALISED | CONDITION_NATIVE) ||
+      !g_variant_try_enabling_conditions (value, CONDITION_SETTLED))
+    return g_variant_get_child_value (value, index);
+
+  gvs.type_info = value->type;
+  gvs.data = value->contents.serialised.data;
+  gvs.size = value->size;
+  gvs = g_variant_serialised_get_child (gvs, index);
+  g_assert (gvs.data != NULL || gvs.size == 0);
+
+  child = (GVariant *) storage;
+  child->ref_count = 1;
+  child->type = gvs.type_info;
+  child->size = gvs.size;
+  child->contents.serialised.source = value;
+  child->contents.serialised.data = gvs.data;
+  child->state = CONDITION_SETTLED | CONDITION_SIZE_KNOWN;
+
+  if (gvs.data == NULL)
+    {
+      child->contents.serialised.source = NULL;
+      child->state |= CONDITION_INDEPENDENT;
+    }
+
+  g_variant_assert_invariant (child);
+
+  return child;
+}
+
+/* < private >
+ * g_variant_release_child_value:
+ * @child: a child returned by g_variant_borrow_child_value()
+ * @storage: the storage passed to g_variant_borrow_child_value()
+ *
+ * Releases @child.
+ */
+void
+g_variant_release_child_value (GVariant             *child,
+                               GVariantChildStorage *storage)
+{
+  if (child != (GVariant *) storage)
+    {
+      g_variant_unref (child);
+      return;
+    }
+
+  /* whoever took a reference on the borrowed child must have dropped it */
+  g_assert_cmpint (child->ref_count, ==, 1);
+  g_variant_type_info_unref (child->type);
+}
+
 /**
  * g_variant_get_size:
  * @value: a #GVariant instance
@@ -1276,7 +1510,7 @@ g_variant_ref_sink (GVariant *value)
   g_variant_assert_invariant (value);
 
   g_variant_ref (value);
-  if (g_atomic_int_compare_and_exchange (&value->floating, 1, 0))
+  if (g_variant_clear_floating (value))
     g_variant_unref (value);
 
   return value;
@@ -1353,7 +1587,7 @@ g_variant_from_slice (const GVariantType *type,
 
       new->contents.serialised.source = NULL;
       new->contents.serialised.data = slice;
-      new->floating = FALSE;
+      new->state &= ~CONDITION_FLOATING;
       new->size = size;
 
       return g_variant_apply_flags (new, flags);
@@ -1416,7 +1650,7 @@ g_variant_from_data (const GVariantType *type,
                              CONDITION_SERIALISED | CONDITION_SIZE_KNOWN);
       new->contents.serialised.source = marker;
       new->contents.serialised.data = (gpointer) data;
-      new->floating = FALSE;
+      new->state &= ~CONDITION_FLOATING;
       new->size = size;
 
       return g_variant_apply_flags (new, flags);
@@ -26,7 +26,7 @@
 #include <string.h>
 #include <errno.h>
 #include <glib.h>
-#include "gvariant.h"
+#include "gvariant-private.h"
 
 /**
  * g_variant_print:
@@ -67,6 +67,8 @@ g_variant_print_string (GVariant *value,
                         gboolean type_annotate)
 {
   const GVariantType *type;
+  gsize n_children;
+  gsize i;
 
   type = g_variant_get_type (value);
 
@@ -77,18 +79,21 @@ g_variant_print_string (GVariant *value,
   {
     case G_VARIANT_CLASS_ARRAY:
       {
-        GVariantIter iter;
+        n_children = g_variant_n_children (value);
 
-        if (g_variant_iter_init (&iter, value))
+        if (n_children > 0)
           {
-            GVariant *element;
-
             g_string_append_c (string, '[');
 
             /* only type annotate the first element (if requested) */
-            while ((element = g_variant_iter_next_value (&iter)))
+            for (i = 0; i < n_children; i++)
               {
+                GVariantChildStorage storage;
+                GVariant *element;
+
+                element = g_variant_borrow_child_value (value, i, &storage);
                 g_variant_print_string (element, string, type_annotate);
+                g_variant_release_child_value (element, &storage);
                 g_string_append (string, ", ");
                 type_annotate = FALSE;
               }
@@ -111,7 +116,10 @@ g_variant_print_string (GVariant *value,
 
     case G_VARIANT_CLASS_VARIANT:
       {
-        GVariant *child = g_variant_get_variant (value);
+        GVariantChildStorage storage;
+        GVariant *child;
+
+        child = g_variant_borrow_child_value (value, 0, &storage);
 
         /* Always annotate types in nested variants, because they are
          * (by nature) of variable type.
@@ -120,22 +128,25 @@ g_variant_print_string (GVariant *value,
         g_variant_print_string (child, string, TRUE);
         g_string_append_c (string, '>');
 
-        g_variant_unref (child);
+        g_variant_release_child_value (child, &storage);
         break;
       }
 
     case G_VARIANT_CLASS_TUPLE:
       {
-        GVariantIter iter;
+        n_children = g_variant_n_children (value);
 
         g_string_append_c (string, '(');
-        if (g_variant_iter_init (&iter, value))
+        if (n_children > 0)
           {
-            GVariant *element;
-
-            while ((element = g_variant_iter_next_value (&iter)))
+            for (i = 0; i < n_children; i++)
               {
+                GVariantChildStorage storage;
+                GVariant *element;
+
+                element = g_variant_borrow_child_value (value, i, &storage);
                 g_variant_print_string (element, string, type_annotate);
+                g_variant_release_child_value (element, &storage);
                 g_string_append (string, ", ");
               }
             g_string_truncate (string, string->len - 2);
@@ -147,27 +158,22 @@ g_variant_print_string (GVariant *value,
 
     case G_VARIANT_CLASS_DICT_ENTRY:
       {
-        GVariantIter iter;
+        GVariantChildStorage storage;
         GVariant *element;
 
         g_string_append_c (string, '{');
 
-        if (g_variant_iter_init (&iter, value))
-          {
-            while ((element = g_variant_iter_next_value (&iter)))
-              {
-                g_variant_print_string (element, string, type_annotate);
+        element = g_variant_borrow_child_value (value, 0, &storage);
+        g_variant_print_string (element, string, type_annotate);
+        g_variant_release_child_value (element, &storage);
 
-                g_string_append_c (string, ':');
+        g_string_append_c (string, ':');
 
-                element = g_variant_iter_next_value (&iter);
-                g_variant_print_string (element, string, type_annotate);
-                g_string_append (string, ", ");
-              }
-            g_string_truncate (string, string->len - 2);
+        element = g_variant_borrow_child_value (value, 1, &storage);
+        g_variant_print_string (element, string, type_annotate);
+        g_variant_release_child_value (element, &storage);
 
-            g_string_append_c (string, '}');
-          }
+        g_string_append_c (string, '}');
 
         break;
       }
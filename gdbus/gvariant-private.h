@@ -23,6 +23,13 @@
 #include "gvarianttypeinfo.h"
 #include "gvariant.h"
 
+/* storage for a child borrowed with g_variant_borrow_child_value() */
+typedef struct
+{
+  /*< private >*/
+  gpointer padding[6];
+} GVariantChildStorage;
+
 /* gvariant-core.c */
 GVariant *                      g_variant_new_tree                      (const GVariantType  *type,
                                                                          GVariant           **children,
@@ -36,8 +43,15 @@ GVariant *                      g_variant_load_fixed                    (const G
                                                                          gsize                n_items);
 gboolean                        g_variant_iter_should_free              (GVariantIter        *iter);
 GVariant *                      g_variant_deep_copy                     (GVariant            *value);
+GVariant *                      g_variant_borrow_child_value            (GVariant            *value,
+                                                                         gsize                index,
+                                                                         GVariantChildStorage *storage);
+void                            g_variant_release_child_value           (GVariant            *child,
+                                                                         GVariantChildStorage *storage);
 
 /* do not use -- only for test cases */
 gboolean                        g_variant_is_normal_                    (GVariant            *value);
+void                            g_variant_get_instance_stats_           (guint               *n_slice_allocs,
+                                                                         guint               *n_reused);
 
 #endif /* __G_VARIANT_PRIVATE_H__ */
@@ -1762,9 +1762,12 @@ g_variant_get_strv (GVariant *value,
 
   for (i = 0; i < my_length; i++)
     {
-      GVariant *child = g_variant_get_child_value (value, i);
+      GVariantChildStorage storage;
+      GVariant *child;
+
+      child = g_variant_borrow_child_value (value, i, &storage);
       result[i] = g_variant_get_string (child, NULL);
-      g_variant_unref (child);
+      g_variant_release_child_value (child, &storage);
     }
   result[i] = NULL;
 
@@ -1810,9 +1813,12 @@ g_variant_dup_strv (GVariant *value,
 
   for (i = 0; i < my_length; i++)
     {
-      GVariant *child = g_variant_get_child_value (value, i);
+      GVariantChildStorage storage;
+      GVariant *child;
+
+      child = g_variant_borrow_child_value (value, i, &storage);
       result[i] = g_variant_dup_string (child, NULL);
-      g_variant_unref (child);
+      g_variant_release_child_value (child, &storage);
     }
   result[i] = NULL;
 
@@ -1837,21 +1843,31 @@ GVariant *
 g_variant_lookup_value (GVariant    *dictionary,
                         const gchar *key)
 {
-  GVariantIter iter;
-  const gchar *_key;
-  GVariant *value;
   GVariant *result = NULL;
+  gsize n_children;
+  gsize i;
 
   g_return_val_if_fail (dictionary != NULL, NULL);
   g_return_val_if_fail (key != NULL, NULL);
 
-  g_variant_iter_init (&iter, dictionary);
-  while (g_variant_iter_next (&iter, "{&s*}", &_key, &value))
-    if (strcmp (_key, key) == 0)
-      {
-        result = g_variant_ref (value);
-        g_variant_iter_cancel (&iter);
-      }
+  /* only the value that is returned gets an instance of its own */
+  n_children = g_variant_n_children (dictionary);
+  for (i = 0; i < n_children && result == NULL; i++)
+    {
+      GVariantChildStorage entry_storage;
+      GVariantChildStorage key_storage;
+      GVariant *entry;
+      GVariant *entry_key;
+
+      entry = g_variant_borrow_child_value (dictionary, i, &entry_storage);
+      entry_key = g_variant_borrow_child_value (entry, 0, &key_storage);
+
+      if (strcmp (g_variant_get_string (entry_key, NULL), key) == 0)
+        result = g_variant_get_child_value (entry, 1);
+
+      g_variant_release_child_value (entry_key, &key_storage);
+      g_variant_release_child_value (entry, &entry_storage);
+    }
 
   return result;
 }
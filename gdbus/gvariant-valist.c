@@ -1104,7 +1104,9 @@ g_variant_new (const gchar *format_string,
  * varargs call by the user.
  *
  * The return value will be floating if it was a newly created GVariant
- * instance (for example, if the format string was "(ii)").  In the case
+ * instance (for example, if the format string was "(ii)").  A newly
+ * created container is not serialised until its data is needed; use
+ * g_variant_flatten() to do that up front.  In the case
  * that the format_string was '*', '?', 'r', or a format starting with
  * '@' then the collected #GVariant pointer will be returned unmodified,
  * without adding any additional references.
@@ -1135,7 +1137,10 @@ g_variant_new_va (gpointer      must_be_null,
   else
     g_assert (*format_string == '\0');
 
-  g_variant_flatten (value);
+  /* the value is not flattened here: many values are only ever walked
+   * (e.g. when converted to a D-Bus message) and the tree form is fine
+   * for that.  it gets serialised on demand if its data is needed.
+   */
 
   return value;
 }
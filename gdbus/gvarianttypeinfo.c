@@ -704,6 +704,81 @@ g_variant_type_info_member_info (GVariantTypeInfo *info,
 static GStaticRecMutex g_variant_type_info_lock = G_STATIC_REC_MUTEX_INIT;
 static GHashTable *g_variant_type_info_table;
 
+/* Each thread keeps a small direct-mapped cache of the container type
+ * infos it used most recently so that the common case of looking up
+ * the same few types over and over neither takes the global lock nor
+ * hashes into the global table.  Every entry holds a reference, so an
+ * info found in the cache can never be freed under our feet and the
+ * reference for the caller can be taken with a plain atomic increment.
+ */
+#define TYPE_INFO_THREAD_CACHE_SIZE 16
+
+typedef struct
+{
+  ContainerInfo *entries[TYPE_INFO_THREAD_CACHE_SIZE];
+} TypeInfoThreadCache;
+
+static GStaticPrivate g_variant_type_info_thread_cache = G_STATIC_PRIVATE_INIT;
+
+static void
+type_info_thread_cache_free (gpointer data)
+{
+  TypeInfoThreadCache *cache = data;
+  gint i;
+
+  for (i = 0; i < TYPE_INFO_THREAD_CACHE_SIZE; i++)
+    if (cache->entries[i] != NULL)
+      g_variant_type_info_unref ((GVariantTypeInfo *) cache->entries[i]);
+
+  g_slice_free (TypeInfoThreadCache, cache);
+}
+
+/* Looks up (or creates) the info for a container type in the global
+ * table.  The type string is only copied when a new info is created.
+ */
+static GVariantTypeInfo *
+container_info_get (const GVariantType *type,
+                    char                type_char)
+{
+  GVariantTypeInfo *info;
+
+  g_static_rec_mutex_lock (&g_variant_type_info_lock);
+
+  if G_UNLIKELY (g_variant_type_info_table == NULL)
+    g_variant_type_info_table = g_hash_table_new (g_variant_type_hash,
+                                                  g_variant_type_equal);
+
+  info = g_hash_table_lookup (g_variant_type_info_table, type);
+
+  if (info == NULL)
+    {
+      ContainerInfo *container;
+
+      if (type_char == G_VARIANT_TYPE_INFO_CHAR_MAYBE ||
+          type_char == G_VARIANT_TYPE_INFO_CHAR_ARRAY)
+        {
+          container = array_info_new (type);
+        }
+      else /* tuple or dict entry */
+        {
+          container = tuple_info_new (type);
+        }
+
+      info = (GVariantTypeInfo *) container;
+      container->type_string = g_variant_type_dup_string (type);
+      container->ref_count = 1;
+
+      g_hash_table_insert (g_variant_type_info_table,
+                           container->type_string, info);
+    }
+  else
+    g_variant_type_info_ref (info);
+
+  g_static_rec_mutex_unlock (&g_variant_type_info_lock);
+
+  return info;
+}
+
 /* < private >
  * g_variant_type_info_get:
  * @type: a #GVariantType
@@ -729,45 +804,45 @@ g_variant_type_info_get (const GVariantType *type)
       type_char == G_VARIANT_TYPE_INFO_CHAR_TUPLE ||
       type_char == G_VARIANT_TYPE_INFO_CHAR_DICT_ENTRY)
     {
+      TypeInfoThreadCache *cache;
+      ContainerInfo *cached;
       GVariantTypeInfo *info;
-      gchar *type_string;
-
-      if G_UNLIKELY (g_variant_type_info_table == NULL)
-        g_variant_type_info_table = g_hash_table_new (g_str_hash,
-                                                      g_str_equal);
+      guint slot;
 
-      type_string = g_variant_type_dup_string (type);
+      cache = g_static_private_get (&g_variant_type_info_thread_cache);
+      if G_UNLIKELY (cache == NULL)
+        {
+          cache = g_slice_new0 (TypeInfoThreadCache);
+          g_static_private_set (&g_variant_type_info_thread_cache,
+                                cache,
+                                type_info_thread_cache_free);
+        }
 
-      g_static_rec_mutex_lock (&g_variant_type_info_lock);
-      info = g_hash_table_lookup (g_variant_type_info_table, type_string);
+      slot = g_variant_type_hash (type) % TYPE_INFO_THREAD_CACHE_SIZE;
+      cached = cache->entries[slot];
 
-      if (info == NULL)
+      if (cached != NULL &&
+          ((const gchar *) type == cached->type_string ||
+           g_variant_type_equal (type, (const GVariantType *) cached->type_string)))
         {
-          ContainerInfo *container;
-
-          if (type_char == G_VARIANT_TYPE_INFO_CHAR_MAYBE ||
-              type_char == G_VARIANT_TYPE_INFO_CHAR_ARRAY)
-            {
-              container = array_info_new (type);
-            }
-          else /* tuple or dict entry */
-            {
-              container = tuple_info_new (type);
-            }
-
-          info = (GVariantTypeInfo *) container;
-          container->type_string = type_string;
-          container->ref_count = 1;
-
-          g_hash_table_insert (g_variant_type_info_table, type_string, info);
-          type_string = NULL;
+          /* the cache holds a reference, so this can't race with the last unref */
+          g_atomic_int_inc (&cached->ref_count);
+          info = (GVariantTypeInfo *) cached;
         }
       else
-        g_variant_type_info_ref (info);
+        {
+          info = container_info_get (type, type_char);
+
+          /* the entry may have been replaced while creating the members
+           * of a new tuple, so fetch it again before evicting it
+           */
+          cached = cache->entries[slot];
+          cache->entries[slot] = (ContainerInfo *) g_variant_type_info_ref (info);
+          if (cached != NULL)
+            g_variant_type_info_unref ((GVariantTypeInfo *) cached);
+        }
 
-      g_static_rec_mutex_unlock (&g_variant_type_info_lock);
       g_variant_type_info_check (info, 0);
-      g_free (type_string);
 
       return info;
     }
@@ -825,6 +900,23 @@ g_variant_type_info_unref (GVariantTypeInfo *info)
   if (info->container_class)
     {
       ContainerInfo *container = (ContainerInfo *) info;
+      gint ref_count;
+
+      /* references other than the last one are dropped without the
+       * lock; only the last one has to be dropped with the lock held
+       * so that it can't race with a lookup in the table
+       */
+      do
+        {
+          ref_count = g_atomic_int_get (&container->ref_count);
+          g_assert_cmpint (ref_count, >, 0);
+          if (ref_count == 1)
+            break;
+        }
+      while (!g_atomic_int_compare_and_exchange (&container->ref_count,
+                                                 ref_count, ref_count - 1));
+      if (ref_count > 1)
+        return;
 
       g_static_rec_mutex_lock (&g_variant_type_info_lock);
       if (g_atomic_int_dec_and_test (&container->ref_count))
@@ -25,6 +25,9 @@
 
 #include "tests.h"
 
+/* for _g_dbus_connection_get_match_rule_stats() */
+#include "gdbus/gdbusprivate.h"
+
 /* all tests rely on a shared mainloop */
 static GMainLoop *loop = NULL;
 
@@ -313,11 +316,19 @@ test_connection_signals (void)
   guint s1;
   guint s2;
   guint s3;
+  guint s4;
   gint count_s1;
   gint count_s2;
+  gint count_s4;
   gint count_name_owner_changed;
   GError *error;
   gboolean ret;
+  const gchar *destinations[] = {":1.1", ":1.3", NULL};
+  const gchar *object_paths[] = {"/org/gtk/GDBus/ExampleInterface", "/org/gtk/GDBus/SomewhereElse", NULL};
+  guint num_add_match;
+  guint num_remove_match;
+  guint num_add_match_after;
+  guint num_remove_match_after;
 
   error = NULL;
 
@@ -429,15 +440,85 @@ test_connection_signals (void)
   g_assert_cmpint (count_s1, ==, 1);
   g_assert_cmpint (count_s2, ==, 2);
 
+  /**
+   * Make c2 emit "Foo" from two objects, directly to c1 and c3 - c1 should only catch the one
+   * from the object it is listening to, but catch it twice, while c3 listens to any object
+   * and should catch both
+   */
+  count_s4 = 0;
+  s4 = g_dbus_connection_signal_subscribe (c3,
+                                           ":1.2",
+                                           "org.gtk.GDBus.ExampleInterface",
+                                           "Foo",
+                                           NULL, /* match any object path */
+                                           NULL,
+                                           test_connection_signal_handler,
+                                           &count_s4,
+                                           NULL);
+  g_assert (s4 != 0);
+  ret = g_dbus_connection_emit_signal_multi (c2,
+                                             destinations,
+                                             object_paths,
+                                             "org.gtk.GDBus.ExampleInterface",
+                                             "Foo",
+                                             g_variant_new ("(s)", "shared body"),
+                                             &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+  while (!(count_s1 == 2 && count_s2 == 3 && count_s4 == 2))
+    g_main_loop_run (loop);
+  g_assert_cmpint (count_s1, ==, 2);
+  g_assert_cmpint (count_s2, ==, 3);
+  g_assert_cmpint (count_s4, ==, 2);
+  g_dbus_connection_signal_unsubscribe (c3, s4);
+
+  /**
+   * Unsubscribe and immediately subscribe again - the match rule is kept on the bus so
+   * we should still catch "Foo" from c3, and neither RemoveMatch() nor AddMatch() is sent
+   * (checked below, after the deferred removals have had a chance to run)
+   */
+  _g_dbus_connection_get_match_rule_stats (c1, &num_add_match, &num_remove_match);
+  g_dbus_connection_signal_unsubscribe (c1, s2);
+  s2 = g_dbus_connection_signal_subscribe (c1,
+                                           NULL, /* match any sender */
+                                           "org.gtk.GDBus.ExampleInterface",
+                                           "Foo",
+                                           "/org/gtk/GDBus/ExampleInterface",
+                                           NULL,
+                                           test_connection_signal_handler,
+                                           &count_s2,
+                                           NULL);
+  g_assert (s2 != 0);
+  ret = g_dbus_connection_emit_signal (c3,
+                                       NULL, /* destination bus name */
+                                       "/org/gtk/GDBus/ExampleInterface",
+                                       "org.gtk.GDBus.ExampleInterface",
+                                       "Foo",
+                                       NULL,
+                                       &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+  while (!(count_s1 == 2 && count_s2 == 4))
+    g_main_loop_run (loop);
+  g_assert_cmpint (count_s1, ==, 2);
+  g_assert_cmpint (count_s2, ==, 4);
+
   /**
    * Tool around in the mainloop to avoid race conditions and also to check the
    * total amount of NameOwnerChanged signals
    */
   g_timeout_add (500, test_connection_signal_quit_mainloop, NULL);
   g_main_loop_run (loop);
-  g_assert_cmpint (count_s1, ==, 1);
-  g_assert_cmpint (count_s2, ==, 2);
+  g_assert_cmpint (count_s1, ==, 2);
+  g_assert_cmpint (count_s2, ==, 4);
   g_assert_cmpint (count_name_owner_changed, ==, 2);
+  _g_dbus_connection_get_match_rule_stats (c1, &num_add_match_after, &num_remove_match_after);
+  g_assert_cmpint (num_add_match_after, ==, num_add_match);
+  g_assert_cmpint (num_remove_match_after, ==, num_remove_match);
+  /* while c3 did remove the rule for the subscription it dropped */
+  _g_dbus_connection_get_match_rule_stats (c3, &num_add_match_after, &num_remove_match_after);
+  g_assert_cmpint (num_add_match_after, ==, 1);
+  g_assert_cmpint (num_remove_match_after, ==, 1);
 
   /**
    * Now bring down the session bus and check we get the :disconnected signal from each connection.
@@ -461,6 +542,167 @@ test_connection_signals (void)
   g_object_unref (c3);
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check which subscriptions a signal is delivered to */
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* a NULL field is a wildcard; match_sender subscribes to the emitting connection only */
+static const struct
+{
+  gboolean     match_sender;
+  const gchar *interface_name;
+  const gchar *member;
+  const gchar *object_path;
+  const gchar *arg0;
+  gint         expected_count;
+} matching_subscriptions[] =
+{
+  /* catches everything and must come first, see below */
+  {FALSE, NULL, NULL, NULL, NULL, 3},
+  {TRUE, NULL, NULL, NULL, NULL, 3},
+  {FALSE, NULL, NULL, "/org/gtk/GDBus/Matching/A", NULL, 2},
+  {FALSE, "org.gtk.GDBus.MatchingA", NULL, NULL, NULL, 1},
+  {FALSE, NULL, "Foo", NULL, NULL, 2},
+  {FALSE, NULL, NULL, NULL, "hello", 1},
+  /* the only subscription matching on interface and member only */
+  {FALSE, "org.gtk.GDBus.MatchingB", "Foo", NULL, NULL, 1},
+  {FALSE, NULL, NULL, "/org/gtk/GDBus/Matching/Nowhere", NULL, 0},
+  /* every field set */
+  {TRUE, "org.gtk.GDBus.MatchingA", "Foo", "/org/gtk/GDBus/Matching/A", "hello", 1},
+  {TRUE, "org.gtk.GDBus.MatchingA", "Foo", "/org/gtk/GDBus/Matching/A", "world", 0},
+};
+
+static const struct
+{
+  const gchar *object_path;
+  const gchar *interface_name;
+  const gchar *member;
+  const gchar *arg0;
+} matching_emissions[] =
+{
+  {"/org/gtk/GDBus/Matching/A", "org.gtk.GDBus.MatchingA", "Foo", "hello"},
+  {"/org/gtk/GDBus/Matching/B", "org.gtk.GDBus.MatchingB", "Bar", "world"},
+  {"/org/gtk/GDBus/Matching/A", "org.gtk.GDBus.MatchingB", "Foo", NULL},
+};
+
+static const gchar *matching_emitter = NULL;
+
+static void
+test_connection_signal_matching_handler (GDBusConnection *connection,
+                                         const gchar      *sender_name,
+                                         const gchar      *object_path,
+                                         const gchar      *interface_name,
+                                         const gchar      *signal_name,
+                                         GVariant         *parameters,
+                                         gpointer         user_data)
+{
+  gint *counter = user_data;
+
+  /* subscriptions with a wildcard sender also catch signals from the bus itself */
+  if (g_strcmp0 (sender_name, matching_emitter) != 0)
+    return;
+
+  *counter += 1;
+}
+
+static void
+test_connection_signal_matching (void)
+{
+  GDBusConnection *c1;
+  GDBusConnection *c2;
+  guint subscription_ids[G_N_ELEMENTS (matching_subscriptions)];
+  gint counts[G_N_ELEMENTS (matching_subscriptions)];
+  GVariant *result;
+  GError *error;
+  gboolean ret;
+  guint n;
+
+  error = NULL;
+
+  session_bus_up ();
+  c1 = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (c1 != NULL);
+  c2 = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (c2 != NULL);
+  matching_emitter = g_dbus_connection_get_unique_name (c2);
+
+  for (n = 0; n < G_N_ELEMENTS (matching_subscriptions); n++)
+    {
+      counts[n] = 0;
+      subscription_ids[n] = g_dbus_connection_signal_subscribe (c1,
+                                                                matching_subscriptions[n].match_sender ? matching_emitter : NULL,
+                                                                matching_subscriptions[n].interface_name,
+                                                                matching_subscriptions[n].member,
+                                                                matching_subscriptions[n].object_path,
+                                                                matching_subscriptions[n].arg0,
+                                                                test_connection_signal_matching_handler,
+                                                                &counts[n],
+                                                                NULL);
+      g_assert (subscription_ids[n] != 0);
+    }
+
+  /* the round-trip makes sure the bus has seen the match rules before c2 emits */
+  result = g_dbus_connection_invoke_method_sync (c1,
+                                                 "org.freedesktop.DBus",  /* bus_name */
+                                                 "/org/freedesktop/DBus", /* object path */
+                                                 "org.freedesktop.DBus",  /* interface name */
+                                                 "GetId",                 /* method name */
+                                                 NULL,
+                                                 -1,
+                                                 NULL,
+                                                 &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_unref (result);
+
+  for (n = 0; n < G_N_ELEMENTS (matching_emissions); n++)
+    {
+      GVariant *parameters;
+
+      parameters = NULL;
+      if (matching_emissions[n].arg0 != NULL)
+        parameters = g_variant_ref_sink (g_variant_new ("(s)", matching_emissions[n].arg0));
+      ret = g_dbus_connection_emit_signal (c2,
+                                           NULL, /* destination bus name */
+                                           matching_emissions[n].object_path,
+                                           matching_emissions[n].interface_name,
+                                           matching_emissions[n].member,
+                                           parameters,
+                                           &error);
+      g_assert_no_error (error);
+      g_assert (ret);
+      if (parameters != NULL)
+        g_variant_unref (parameters);
+    }
+
+  /**
+   * The catch-all subscription sees every signal - wait for it and then tool around
+   * in the mainloop for a bit so deliveries that should not happen get a chance to
+   */
+  while (counts[0] < (gint) G_N_ELEMENTS (matching_emissions))
+    g_main_context_iteration (NULL, TRUE);
+  g_timeout_add (100, test_connection_signal_quit_mainloop, NULL);
+  g_main_loop_run (loop);
+
+  for (n = 0; n < G_N_ELEMENTS (matching_subscriptions); n++)
+    {
+      g_assert_cmpint (counts[n], ==, matching_subscriptions[n].expected_count);
+      g_dbus_connection_signal_unsubscribe (c1, subscription_ids[n]);
+    }
+
+  g_dbus_connection_set_exit_on_disconnect (c1, FALSE);
+  g_dbus_connection_set_exit_on_disconnect (c2, FALSE);
+  session_bus_down ();
+  if (!g_dbus_connection_get_is_disconnected (c1))
+    _g_assert_signal_received (c1, "disconnected");
+  if (!g_dbus_connection_get_is_disconnected (c2))
+    _g_assert_signal_received (c2, "disconnected");
+  g_object_unref (c1);
+  g_object_unref (c2);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 int
@@ -482,5 +724,6 @@ main (int   argc,
   g_test_add_func ("/gdbus/connection-life-cycle", test_connection_life_cycle);
   g_test_add_func ("/gdbus/connection-send", test_connection_send);
   g_test_add_func ("/gdbus/connection-signals", test_connection_signals);
+  g_test_add_func ("/gdbus/connection-signal-matching", test_connection_signal_matching);
   return g_test_run();
 }
@@ -0,0 +1,817 @@
+/* GLib testing framework examples and tests
+ *
+ * Copyright (C) 2008-2009 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ * Author: David Zeuthen <davidz@redhat.com>
+ */
+
+#include <gdbus/gdbus.h>
+#include <dbus/dbus.h>
+#include <string.h>
+
+/* the conversion routines are private so this test is built with gdbusconversion.c */
+#include "gdbus/gdbusconversion.h"
+#include "gdbus/gvariant-private.h"
+
+#include "tests.h"
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static DBusMessage *
+new_message (void)
+{
+  DBusMessage *message;
+
+  message = dbus_message_new_signal ("/org/gtk/GDBus/ConversionTestObject",
+                                     "org.gtk.GDBus.ConversionTestInterface",
+                                     "Test");
+  g_assert (message != NULL);
+
+  return message;
+}
+
+static void
+append_byte_array (DBusMessageIter *iter,
+                   guint            num_bytes)
+{
+  DBusMessageIter array_iter;
+  guint n;
+
+  g_assert (dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, "y", &array_iter));
+  for (n = 0; n < num_bytes; n++)
+    {
+      guchar v = n & 0xff;
+      g_assert (dbus_message_iter_append_basic (&array_iter, DBUS_TYPE_BYTE, &v));
+    }
+  g_assert (dbus_message_iter_close_container (iter, &array_iter));
+}
+
+static void
+append_variant_basic (DBusMessageIter *iter,
+                      gint             type,
+                      gconstpointer    value)
+{
+  DBusMessageIter variant_iter;
+  gchar signature[2];
+
+  signature[0] = type;
+  signature[1] = '\0';
+  g_assert (dbus_message_iter_open_container (iter, DBUS_TYPE_VARIANT, signature, &variant_iter));
+  g_assert (dbus_message_iter_append_basic (&variant_iter, type, value));
+  g_assert (dbus_message_iter_close_container (iter, &variant_iter));
+}
+
+/* appends an a{sv} with a mix of value types, like what a PropertiesChanged signal carries */
+static void
+append_dict (DBusMessageIter *iter,
+             guint            num_entries)
+{
+  DBusMessageIter array_iter;
+  guint n;
+
+  g_assert (dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, "{sv}", &array_iter));
+  for (n = 0; n < num_entries; n++)
+    {
+      DBusMessageIter entry_iter;
+      DBusMessageIter variant_iter;
+      DBusMessageIter sub_iter;
+      gchar *key;
+      const gchar *s;
+      dbus_int32_t i;
+      dbus_uint64_t t;
+      dbus_bool_t b;
+      gdouble d;
+
+      key = g_strdup_printf ("Key%d", n);
+      g_assert (dbus_message_iter_open_container (&array_iter, DBUS_TYPE_DICT_ENTRY, NULL, &entry_iter));
+      g_assert (dbus_message_iter_append_basic (&entry_iter, DBUS_TYPE_STRING, &key));
+      switch (n % 6)
+        {
+        case 0:
+          i = n;
+          append_variant_basic (&entry_iter, DBUS_TYPE_INT32, &i);
+          break;
+
+        case 1:
+          s = "a string value";
+          append_variant_basic (&entry_iter, DBUS_TYPE_STRING, &s);
+          break;
+
+        case 2:
+          t = G_GUINT64_CONSTANT (0x0123456789abcdef) + n;
+          append_variant_basic (&entry_iter, DBUS_TYPE_UINT64, &t);
+          break;
+
+        case 3:
+          b = (n & 1);
+          append_variant_basic (&entry_iter, DBUS_TYPE_BOOLEAN, &b);
+          break;
+
+        case 4:
+          d = n / 3.0;
+          append_variant_basic (&entry_iter, DBUS_TYPE_DOUBLE, &d);
+          break;
+
+        case 5:
+          /* an (sai) struct in a variant */
+          g_assert (dbus_message_iter_open_container (&entry_iter, DBUS_TYPE_VARIANT, "(sai)", &variant_iter));
+          g_assert (dbus_message_iter_open_container (&variant_iter, DBUS_TYPE_STRUCT, NULL, &sub_iter));
+          s = key;
+          g_assert (dbus_message_iter_append_basic (&sub_iter, DBUS_TYPE_STRING, &s));
+          {
+            DBusMessageIter ai_iter;
+            g_assert (dbus_message_iter_open_container (&sub_iter, DBUS_TYPE_ARRAY, "i", &ai_iter));
+            for (i = 0; i < (dbus_int32_t) (n % 4); i++)
+              g_assert (dbus_message_iter_append_basic (&ai_iter, DBUS_TYPE_INT32, &i));
+            g_assert (dbus_message_iter_close_container (&sub_iter, &ai_iter));
+          }
+          g_assert (dbus_message_iter_close_container (&variant_iter, &sub_iter));
+          g_assert (dbus_message_iter_close_container (&entry_iter, &variant_iter));
+          break;
+        }
+      g_assert (dbus_message_iter_close_container (&array_iter, &entry_iter));
+      g_free (key);
+    }
+  g_assert (dbus_message_iter_close_container (iter, &array_iter));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* The conversion gdbusconversion.c used before messages were serialised
+ * directly: one GVariant instance per value, assembled with a builder.
+ * It is only kept here to check and benchmark the serialising conversion.
+ */
+
+static GVariant *
+dconf_dbus_to_gv (DBusMessageIter  *iter,
+                  GError          **error)
+{
+  gint arg_type;
+
+  arg_type = dbus_message_iter_get_arg_type (iter);
+
+  switch (dbus_message_iter_get_arg_type (iter))
+    {
+     case DBUS_TYPE_BOOLEAN:
+      {
+        dbus_bool_t value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_boolean (value);
+      }
+
+     case DBUS_TYPE_BYTE:
+      {
+        guchar value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_byte (value);
+      }
+
+     case DBUS_TYPE_INT16:
+      {
+        gint16 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_int16 (value);
+      }
+
+     case DBUS_TYPE_UINT16:
+      {
+        guint16 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_uint16 (value);
+      }
+
+     case DBUS_TYPE_INT32:
+      {
+        gint32 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_int32 (value);
+      }
+
+     case DBUS_TYPE_UINT32:
+      {
+        guint32 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_uint32 (value);
+      }
+
+     case DBUS_TYPE_INT64:
+      {
+        gint64 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_int64 (value);
+      }
+
+     case DBUS_TYPE_UINT64:
+      {
+        guint64 value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_uint64 (value);
+      }
+
+     case DBUS_TYPE_DOUBLE:
+      {
+        gdouble value;
+        dbus_message_iter_get_basic (iter, &value);
+        return g_variant_new_double (value);
+      }
+
+     case DBUS_TYPE_STRING:
+      {
+       const gchar *value;
+       dbus_message_iter_get_basic (iter, &value);
+       return g_variant_new_string (value);
+      }
+
+     case DBUS_TYPE_OBJECT_PATH:
+      {
+       const gchar *value;
+       dbus_message_iter_get_basic (iter, &value);
+       return g_variant_new_object_path (value);
+      }
+
+     case DBUS_TYPE_SIGNATURE:
+      {
+       const gchar *value;
+       dbus_message_iter_get_basic (iter, &value);
+       return g_variant_new_signature (value);
+      }
+
+     case DBUS_TYPE_VARIANT:
+       {
+        GVariantBuilder *builder;
+        GVariantClass class;
+        DBusMessageIter sub;
+        char *type;
+        GVariant *val;
+
+        dbus_message_iter_recurse (iter, &sub);
+        class = dbus_message_iter_get_arg_type (iter);
+        type = dbus_message_iter_get_signature (&sub);
+        builder = g_variant_builder_new (G_VARIANT_TYPE_VARIANT);
+        dbus_free (type);
+
+        while (dbus_message_iter_get_arg_type (&sub))
+          {
+            val = dconf_dbus_to_gv (&sub, error);
+            if (val == NULL)
+              {
+                g_variant_builder_cancel (builder);
+                goto fail;
+              }
+            g_variant_builder_add_value (builder, val);
+            dbus_message_iter_next (&sub);
+          }
+
+        return g_variant_builder_end (builder);
+       }
+
+     case DBUS_TYPE_ARRAY:
+     case DBUS_TYPE_STRUCT:
+     case DBUS_TYPE_DICT_ENTRY:
+      {
+        GVariantBuilder *builder;
+        GVariantClass class;
+        DBusMessageIter sub;
+        char *type;
+        GVariant *val;
+
+        dbus_message_iter_recurse (iter, &sub);
+        class = dbus_message_iter_get_arg_type (iter);
+        type = dbus_message_iter_get_signature (iter);
+        builder = g_variant_builder_new (G_VARIANT_TYPE (type));
+        dbus_free (type);
+
+        while (dbus_message_iter_get_arg_type (&sub))
+          {
+            val = dconf_dbus_to_gv (&sub, error);
+            if (val == NULL)
+              {
+                g_variant_builder_cancel (builder);
+                goto fail;
+              }
+            g_variant_builder_add_value (builder, val);
+            dbus_message_iter_next (&sub);
+          }
+
+        return g_variant_builder_end (builder);
+      }
+
+     default:
+       g_set_error (error,
+                    G_DBUS_ERROR,
+                    G_DBUS_ERROR_CONVERSION_FAILED,
+                    "Error serializing D-Bus message to GVariant. Unsupported arg type `%c' (%d)",
+                    arg_type,
+                    arg_type);
+      goto fail;
+    }
+
+  g_assert_not_reached ();
+
+ fail:
+  return NULL;
+}
+
+static GVariant *
+dbus_1_to_gvariant_tree (DBusMessage  *message,
+                         GError      **error)
+{
+  DBusMessageIter iter;
+  GVariantBuilder *builder;
+  guint n;
+  GVariant *result;
+
+  g_assert (message != NULL);
+  g_assert (dbus_message_get_type (message) != DBUS_MESSAGE_TYPE_ERROR);
+
+  result = NULL;
+
+  dbus_message_iter_init (message, &iter);
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE_TUPLE);
+  n = 0;
+  while (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_INVALID)
+    {
+      GVariant *item;
+
+      item = dconf_dbus_to_gv (&iter, error);
+      if (item == NULL)
+        {
+          g_variant_builder_cancel (builder);
+          g_prefix_error (error,
+                          "Error decoding out-arg %d: ",
+                          n);
+          goto out;
+        }
+      g_variant_builder_add_value (builder, item);
+      dbus_message_iter_next (&iter);
+      n++;
+    }
+
+  result = g_variant_ref_sink (g_variant_builder_end (builder));
+
+ out:
+
+  return result;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* checks that both conversions result in the same serialised data */
+static void
+check_conversions_match (DBusMessage *message)
+{
+  GVariant *serialised;
+  GVariant *tree;
+  GError *error;
+  gchar *s1;
+  gchar *s2;
+
+  error = NULL;
+  serialised = _g_dbus_dbus_1_to_gvariant (message, &error);
+  g_assert_no_error (error);
+  g_assert (serialised != NULL);
+
+  tree = dbus_1_to_gvariant_tree (message, &error);
+  g_assert_no_error (error);
+  g_assert (tree != NULL);
+
+  g_assert_cmpstr (g_variant_get_type_string (serialised), ==, g_variant_get_type_string (tree));
+  g_assert_cmpint (g_variant_get_size (serialised), ==, g_variant_get_size (tree));
+  g_assert (memcmp (g_variant_get_data (serialised),
+                    g_variant_get_data (tree),
+                    g_variant_get_size (tree)) == 0);
+
+  s1 = g_variant_print (serialised, TRUE);
+  s2 = g_variant_print (tree, TRUE);
+  g_assert_cmpstr (s1, ==, s2);
+  g_free (s1);
+  g_free (s2);
+
+  g_variant_unref (serialised);
+  g_variant_unref (tree);
+}
+
+static void
+test_serialised_conversion (void)
+{
+  DBusMessage *message;
+  DBusMessageIter iter;
+  DBusMessageIter struct_iter;
+  const gchar *s;
+  const gchar *o;
+  const gchar *g;
+  guchar y;
+  dbus_int16_t n;
+  dbus_uint32_t u;
+  dbus_int64_t x;
+
+  /* no arguments */
+  message = new_message ();
+  check_conversions_match (message);
+  dbus_message_unref (message);
+
+  /* basic types, with padding between them */
+  message = new_message ();
+  y = 42;
+  n = -2;
+  u = 0xdeadbeef;
+  x = G_GINT64_CONSTANT (-12345678901);
+  s = "a string";
+  o = "/an/object/path";
+  g = "a{sv}";
+  g_assert (dbus_message_append_args (message,
+                                      DBUS_TYPE_BYTE, &y,
+                                      DBUS_TYPE_STRING, &s,
+                                      DBUS_TYPE_INT16, &n,
+                                      DBUS_TYPE_UINT32, &u,
+                                      DBUS_TYPE_OBJECT_PATH, &o,
+                                      DBUS_TYPE_INT64, &x,
+                                      DBUS_TYPE_SIGNATURE, &g,
+                                      DBUS_TYPE_INVALID));
+  check_conversions_match (message);
+  dbus_message_unref (message);
+
+  /* containers - including empty ones and ones needing 2 and 4 byte framing offsets */
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+  append_byte_array (&iter, 0);
+  append_dict (&iter, 0);
+  append_byte_array (&iter, 1000);
+  append_dict (&iter, 10);
+  g_assert (dbus_message_iter_open_container (&iter, DBUS_TYPE_STRUCT, NULL, &struct_iter));
+  g_assert (dbus_message_iter_append_basic (&struct_iter, DBUS_TYPE_BYTE, &y));
+  g_assert (dbus_message_iter_append_basic (&struct_iter, DBUS_TYPE_UINT32, &u));
+  g_assert (dbus_message_iter_close_container (&iter, &struct_iter));
+  append_dict (&iter, 5000);
+  check_conversions_match (message);
+  dbus_message_unref (message);
+}
+
+/* returns the number of instances created by this thread so far */
+static guint
+get_n_instances (void)
+{
+  guint n_slice_allocs;
+  guint n_reused;
+
+  g_variant_get_instance_stats_ (&n_slice_allocs, &n_reused);
+
+  return n_slice_allocs + n_reused;
+}
+
+/* checks that walking serialised containers borrows the children instead of creating instances */
+static void
+test_borrowed_children (void)
+{
+  DBusMessage *message;
+  DBusMessageIter iter;
+  const gchar *strv[] = { "one", "two", "three", NULL };
+  const gchar **strv_p;
+  const gchar **strv2;
+  GVariant *value;
+  GVariant *dict;
+  GVariant *strings;
+  GVariant *found;
+  GError *error;
+  gchar *s;
+  guint n_instances;
+
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+  append_dict (&iter, 10);
+  strv_p = strv;
+  g_assert (dbus_message_append_args (message,
+                                      DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &strv_p, 3,
+                                      DBUS_TYPE_INVALID));
+
+  error = NULL;
+  value = _g_dbus_dbus_1_to_gvariant (message, &error);
+  g_assert_no_error (error);
+  dict = g_variant_get_child_value (value, 0);
+  strings = g_variant_get_child_value (value, 1);
+
+  n_instances = get_n_instances ();
+  s = g_variant_print (dict, FALSE);
+  g_assert_cmpint (get_n_instances (), ==, n_instances);
+  g_assert (strstr (s, "\"Key3\"") != NULL);
+  g_free (s);
+
+  n_instances = get_n_instances ();
+  strv2 = g_variant_get_strv (strings, NULL);
+  g_assert_cmpint (get_n_instances (), ==, n_instances);
+  g_assert_cmpint (g_strv_length ((gchar **) strv2), ==, 3);
+  g_assert_cmpstr (strv2[2], ==, "three");
+  g_free (strv2);
+
+  /* only the value that is found is created */
+  n_instances = get_n_instances ();
+  found = g_variant_lookup_value (dict, "Key3");
+  g_assert_cmpint (get_n_instances (), ==, n_instances + 1);
+  g_assert (found != NULL);
+  g_assert_cmpstr (g_variant_get_type_string (found), ==, "v");
+  g_variant_unref (found);
+  g_assert (g_variant_lookup_value (dict, "NoSuchKey") == NULL);
+
+  g_variant_unref (strings);
+  g_variant_unref (dict);
+  g_variant_unref (value);
+  dbus_message_unref (message);
+}
+
+/* checks that arrays of fixed-size types survive a round-trip through GVariant */
+static void
+test_fixed_array_conversion (void)
+{
+  DBusMessage *message;
+  DBusMessage *message2;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+  GVariant *value;
+  GVariant *value2;
+  GError *error;
+  guchar ay[7];
+  dbus_int16_t an[5];
+  dbus_uint32_t au[3];
+  dbus_int64_t ax[4];
+  gdouble ad[6];
+  const guchar *empty;
+  gchar *s1;
+  gchar *s2;
+  guint n;
+  const guchar *p_ay = ay;
+  const dbus_int16_t *p_an = an;
+  const dbus_uint32_t *p_au = au;
+  const dbus_int64_t *p_ax = ax;
+  const gdouble *p_ad = ad;
+
+  for (n = 0; n < G_N_ELEMENTS (ay); n++)
+    ay[n] = n * 37;
+  for (n = 0; n < G_N_ELEMENTS (an); n++)
+    an[n] = -1000 * n;
+  for (n = 0; n < G_N_ELEMENTS (au); n++)
+    au[n] = 0xdeadbeef - n;
+  for (n = 0; n < G_N_ELEMENTS (ax); n++)
+    ax[n] = G_GINT64_CONSTANT (-12345678901) * n;
+  for (n = 0; n < G_N_ELEMENTS (ad); n++)
+    ad[n] = n / 7.0;
+  empty = NULL;
+
+  /* mix of element sizes so the arrays start at different alignments */
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+#define APPEND_FIXED_ARRAY(sig, type, ptr, len)                                                       \
+  G_STMT_START {                                                                                      \
+    g_assert (dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, sig, &array_iter));           \
+    g_assert (dbus_message_iter_append_fixed_array (&array_iter, type, ptr, len));                    \
+    g_assert (dbus_message_iter_close_container (&iter, &array_iter));                                \
+  } G_STMT_END
+  APPEND_FIXED_ARRAY ("y", DBUS_TYPE_BYTE, &p_ay, G_N_ELEMENTS (ay));
+  APPEND_FIXED_ARRAY ("y", DBUS_TYPE_BYTE, &empty, 0);
+  APPEND_FIXED_ARRAY ("n", DBUS_TYPE_INT16, &p_an, G_N_ELEMENTS (an));
+  APPEND_FIXED_ARRAY ("x", DBUS_TYPE_INT64, &p_ax, G_N_ELEMENTS (ax));
+  APPEND_FIXED_ARRAY ("u", DBUS_TYPE_UINT32, &p_au, G_N_ELEMENTS (au));
+  APPEND_FIXED_ARRAY ("d", DBUS_TYPE_DOUBLE, &p_ad, G_N_ELEMENTS (ad));
+#undef APPEND_FIXED_ARRAY
+  check_conversions_match (message);
+
+  error = NULL;
+  value = _g_dbus_dbus_1_to_gvariant (message, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (g_variant_get_type_string (value), ==, "(ayaynaxauad)");
+
+  message2 = new_message ();
+  g_assert (_g_dbus_gvariant_to_dbus_1 (message2, value, &error));
+  g_assert_no_error (error);
+  g_assert_cmpstr (dbus_message_get_signature (message2), ==, "ayaynaxauad");
+  check_conversions_match (message2);
+
+  value2 = _g_dbus_dbus_1_to_gvariant (message2, &error);
+  g_assert_no_error (error);
+  s1 = g_variant_print (value, TRUE);
+  s2 = g_variant_print (value2, TRUE);
+  g_assert_cmpstr (s1, ==, s2);
+  g_free (s1);
+  g_free (s2);
+
+  g_variant_unref (value);
+  g_variant_unref (value2);
+  dbus_message_unref (message);
+  dbus_message_unref (message2);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Compare the cost of the two conversions (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define CONVERSION_NUM_ITERATIONS 100
+
+static gdouble
+time_conversion (DBusMessage *message,
+                 GVariant *(*convert) (DBusMessage *, GError **))
+{
+  GTimer *timer;
+  gdouble elapsed;
+  guint n;
+
+  timer = g_timer_new ();
+  for (n = 0; n < CONVERSION_NUM_ITERATIONS; n++)
+    {
+      GVariant *value;
+      GError *error;
+
+      error = NULL;
+      value = convert (message, &error);
+      g_assert_no_error (error);
+      g_variant_unref (value);
+    }
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return elapsed / CONVERSION_NUM_ITERATIONS;
+}
+
+/* takes every entry of an a{sv} apart, which creates a short-lived instance per child */
+static void
+decode_dict (GVariant *dict)
+{
+  gsize n;
+
+  for (n = 0; n < g_variant_n_children (dict); n++)
+    {
+      GVariant *entry;
+      GVariant *key;
+      GVariant *variant;
+      GVariant *value;
+
+      entry = g_variant_get_child_value (dict, n);
+      key = g_variant_get_child_value (entry, 0);
+      variant = g_variant_get_child_value (entry, 1);
+      value = g_variant_get_variant (variant);
+      g_variant_unref (value);
+      g_variant_unref (variant);
+      g_variant_unref (key);
+      g_variant_unref (entry);
+    }
+}
+
+static void
+time_decode (DBusMessage *message,
+             const gchar *description)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  guint slice_allocs_before, reused_before;
+  guint slice_allocs, reused;
+  guint n;
+
+  g_variant_get_instance_stats_ (&slice_allocs_before, &reused_before);
+
+  timer = g_timer_new ();
+  for (n = 0; n < CONVERSION_NUM_ITERATIONS; n++)
+    {
+      GVariant *value;
+      GVariant *dict;
+      GError *error;
+
+      error = NULL;
+      value = _g_dbus_dbus_1_to_gvariant (message, &error);
+      g_assert_no_error (error);
+      dict = g_variant_get_child_value (value, 0);
+      decode_dict (dict);
+      g_variant_unref (dict);
+      g_variant_unref (value);
+    }
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_variant_get_instance_stats_ (&slice_allocs, &reused);
+  slice_allocs -= slice_allocs_before;
+  reused -= reused_before;
+
+  g_test_maximized_result ((slice_allocs + reused) / elapsed,
+                           "%s, decode: %.0f instances/sec",
+                           description, (slice_allocs + reused) / elapsed);
+  g_test_minimized_result ((gdouble) slice_allocs / CONVERSION_NUM_ITERATIONS,
+                           "%s, decode: %.1f slice allocations per message (%.1f instances reused)",
+                           description,
+                           (gdouble) slice_allocs / CONVERSION_NUM_ITERATIONS,
+                           (gdouble) reused / CONVERSION_NUM_ITERATIONS);
+}
+
+static void
+test_conversion_perf (void)
+{
+  DBusMessage *message;
+  DBusMessageIter iter;
+  gdouble serialised;
+  gdouble tree;
+
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+  append_byte_array (&iter, 1024 * 1024);
+  serialised = time_conversion (message, _g_dbus_dbus_1_to_gvariant);
+  tree = time_conversion (message, dbus_1_to_gvariant_tree);
+  g_test_minimized_result (serialised, "ay (1 MiB), serialised: %.3f msec", serialised * 1000);
+  g_test_minimized_result (tree, "ay (1 MiB), tree: %.3f msec", tree * 1000);
+  dbus_message_unref (message);
+
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+  append_dict (&iter, 10000);
+  serialised = time_conversion (message, _g_dbus_dbus_1_to_gvariant);
+  tree = time_conversion (message, dbus_1_to_gvariant_tree);
+  g_test_minimized_result (serialised, "a{sv} (10000 entries), serialised: %.3f msec", serialised * 1000);
+  g_test_minimized_result (tree, "a{sv} (10000 entries), tree: %.3f msec", tree * 1000);
+  time_decode (message, "a{sv} (10000 entries)");
+  dbus_message_unref (message);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define THREADED_CONVERSION_NUM_ITERATIONS 2000
+
+/* builds GVariants from its own message so the only thing shared between threads is GVariant itself */
+static gpointer
+threaded_conversion_thread_func (gpointer user_data)
+{
+  DBusMessage *message;
+  DBusMessageIter iter;
+  guint n;
+
+  message = new_message ();
+  dbus_message_iter_init_append (message, &iter);
+  append_dict (&iter, 20);
+
+  for (n = 0; n < THREADED_CONVERSION_NUM_ITERATIONS; n++)
+    {
+      GVariant *value;
+      GVariant *dict;
+      GError *error;
+      gsize m;
+
+      error = NULL;
+      value = dbus_1_to_gvariant_tree (message, &error);
+      g_assert_no_error (error);
+      g_variant_unref (value);
+
+      value = _g_dbus_dbus_1_to_gvariant (message, &error);
+      g_assert_no_error (error);
+      dict = g_variant_get_child_value (value, 0);
+      for (m = 0; m < g_variant_n_children (dict); m++)
+        g_variant_unref (g_variant_get_child_value (dict, m));
+      g_variant_unref (dict);
+      g_variant_unref (value);
+    }
+
+  dbus_message_unref (message);
+
+  return NULL;
+}
+
+static void
+test_threaded_conversion_perf (void)
+{
+  _g_test_thread_scaling ("conversions",
+                          THREADED_CONVERSION_NUM_ITERATIONS,
+                          NULL,
+                          threaded_conversion_thread_func,
+                          NULL);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_thread_init (NULL);
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gdbus/conversion/serialised", test_serialised_conversion);
+  g_test_add_func ("/gdbus/conversion/fixed-arrays", test_fixed_array_conversion);
+  g_test_add_func ("/gdbus/conversion/borrowed-children", test_borrowed_children);
+  if (g_test_perf ())
+    {
+      g_test_add_func ("/gdbus/conversion/perf", test_conversion_perf);
+      g_test_add_func ("/gdbus/conversion/threaded-perf", test_threaded_conversion_perf);
+    }
+
+  return g_test_run();
+}
@@ -428,6 +428,63 @@ dyna_create (GDBusConnection *c,
   return;
 }
 
+static void
+dyna_invalid_args_callback (GDBusProxy   *proxy,
+                            GAsyncResult *res,
+                            gpointer      user_data)
+{
+  GVariant *result;
+  GError *error;
+
+  error = NULL;
+  result = g_dbus_proxy_invoke_method_finish (proxy,
+                                              res,
+                                              &error);
+  g_assert_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS);
+  g_assert (result == NULL);
+  g_error_free (error);
+
+  g_main_loop_quit (loop);
+}
+
+/* Call DynaCyber on @object_name under /foo/dyna with parameters not matching its in signature */
+static void
+dyna_call_with_invalid_args (GDBusConnection *c,
+                             const gchar     *object_name)
+{
+  GError *error;
+  GDBusProxy *proxy;
+  gchar *object_path;
+
+  object_path = g_strconcat ("/foo/dyna/", object_name, NULL);
+
+  error = NULL;
+  proxy = g_dbus_proxy_new_sync (c,
+                                 G_TYPE_DBUS_PROXY,
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                 G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                                 g_dbus_connection_get_unique_name (c),
+                                 object_path,
+                                 "org.example.Dyna",
+                                 NULL,
+                                 &error);
+  g_assert_no_error (error);
+  g_assert (proxy != NULL);
+
+  /* do this async to avoid libdbus-1 deadlocks */
+  g_dbus_proxy_invoke_method (proxy,
+                              "DynaCyber",
+                              g_variant_new ("(s)", "unexpected"),
+                              -1,
+                              NULL,
+                              (GAsyncReadyCallback) dyna_invalid_args_callback,
+                              NULL);
+  g_main_loop_run (loop);
+
+  g_object_unref (proxy);
+  g_free (object_path);
+}
+
 typedef struct
 {
   guint num_unregistered_calls;
@@ -663,6 +720,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -676,6 +734,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -689,6 +748,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -702,6 +762,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -715,6 +776,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -741,6 +803,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -756,6 +819,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -770,6 +834,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -785,6 +850,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -804,6 +870,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -817,6 +884,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -874,6 +942,7 @@ test_object_registration (void)
                                                        bar_interface_info.name,
                                                        &bar_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -886,6 +955,7 @@ test_object_registration (void)
                                                        foo_interface_info.name,
                                                        &foo_interface_info,
                                                        NULL,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
                                                        &data,
                                                        on_object_unregistered,
                                                        &error);
@@ -941,6 +1011,9 @@ test_object_registration (void)
   g_strfreev (nodes);
   g_assert_cmpint (count_interfaces (c, "/foo/dyna/dynamicallycreated"), ==, 4);
 
+  /* Check that a call with the wrong signature is rejected */
+  dyna_call_with_invalid_args (c, "dynamicallycreated");
+
 
   /* now check that the object hierarachy is properly generated... yes, it's a bit
    * perverse that we round-trip to the bus to introspect ourselves ;-)
@@ -140,6 +140,89 @@ test_introspection_parser (void)
 }
 
 
+/* ---------------------------------------------------------------------------------------------------- */
+/* Test that lookups through the interface info cache match the linear search */
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+check_lookups (const GDBusInterfaceInfo *interface_info,
+               guint                     num_members)
+{
+  const GDBusMethodInfo *method_info;
+  const GDBusSignalInfo *signal_info;
+  const GDBusPropertyInfo *property_info;
+  guint n;
+
+  for (n = 0; n < num_members; n++)
+    {
+      gchar *name;
+
+      name = g_strdup_printf ("Method%d", n);
+      method_info = g_dbus_interface_info_lookup_method (interface_info, name);
+      g_assert (method_info == interface_info->methods + n);
+      g_free (name);
+
+      name = g_strdup_printf ("Signal%d", n);
+      signal_info = g_dbus_interface_info_lookup_signal (interface_info, name);
+      g_assert (signal_info == interface_info->signals + n);
+      g_free (name);
+
+      name = g_strdup_printf ("Property%d", n);
+      property_info = g_dbus_interface_info_lookup_property (interface_info, name);
+      g_assert (property_info == interface_info->properties + n);
+      g_free (name);
+    }
+
+  g_assert (g_dbus_interface_info_lookup_method (interface_info, "NonExistantMethod") == NULL);
+  g_assert (g_dbus_interface_info_lookup_signal (interface_info, "NonExistantSignal") == NULL);
+  g_assert (g_dbus_interface_info_lookup_property (interface_info, "NonExistantProperty") == NULL);
+}
+
+static void
+test_introspection_cache (void)
+{
+  GError *error;
+  GString *xml;
+  GDBusNodeInfo *node_info;
+  const GDBusInterfaceInfo *interface_info;
+  guint n;
+
+  xml = g_string_new ("<node><interface name='com.example.Big'>");
+  for (n = 0; n < 200; n++)
+    {
+      g_string_append_printf (xml, "<method name='Method%d'><arg type='s' direction='in'/></method>", n);
+      g_string_append_printf (xml, "<signal name='Signal%d'><arg type='i'/></signal>", n);
+      g_string_append_printf (xml, "<property name='Property%d' type='u' access='read'/>", n);
+    }
+  g_string_append (xml, "</interface></node>");
+
+  error = NULL;
+  node_info = g_dbus_node_info_new_for_xml (xml->str, &error);
+  g_assert_no_error (error);
+  g_assert (node_info != NULL);
+  g_string_free (xml, TRUE);
+
+  interface_info = g_dbus_node_info_lookup_interface (node_info, "com.example.Big");
+  g_assert (interface_info != NULL);
+  g_assert_cmpint (interface_info->num_methods, ==, 200);
+
+  /* without a cache */
+  check_lookups (interface_info, 200);
+
+  /* with a cache - and building it twice only bumps the use count */
+  g_dbus_interface_info_cache_build (interface_info);
+  g_dbus_interface_info_cache_build (interface_info);
+  check_lookups (interface_info, 200);
+  g_dbus_interface_info_cache_release (interface_info);
+  check_lookups (interface_info, 200);
+  g_dbus_interface_info_cache_release (interface_info);
+
+  /* and without it again */
+  check_lookups (interface_info, 200);
+
+  g_dbus_node_info_free (node_info);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 int
@@ -159,5 +242,6 @@ main (int   argc,
   g_setenv ("DBUS_SESSION_BUS_ADDRESS", session_bus_get_temporary_address (), TRUE);
 
   g_test_add_func ("/gdbus/introspection-parser", test_introspection_parser);
+  g_test_add_func ("/gdbus/introspection-cache", test_introspection_cache);
   return g_test_run();
 }
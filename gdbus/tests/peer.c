@@ -21,6 +21,7 @@
  */
 
 #include <gdbus/gdbus.h>
+#include <dbus/dbus.h>
 #include <unistd.h>
 #include <string.h>
 
@@ -37,9 +38,11 @@ static GMainLoop *loop = NULL;
 typedef struct
 {
   gboolean accept_connection;
+  GDBusRegisterObjectFlags register_flags;
   gint num_connection_attempts;
   GPtrArray *current_connections;
   guint num_method_calls;
+  guint num_direct_method_calls;
 } PeerData;
 
 static const GDBusArgInfo test_interface_hello_peer_method_in_args[] =
@@ -111,6 +114,7 @@ test_interface_method_call (GDBusConnection       *connection,
                             GDBusMethodInvocation *invocation)
 {
   PeerData *data = user_data;
+  GSource *source;
 
   g_assert_cmpstr (object_path, ==, "/org/gtk/GDBus/PeerTestObject");
   g_assert_cmpstr (interface_name, ==, "org.gtk.GDBus.PeerTestInterface");
@@ -148,6 +152,12 @@ test_interface_method_call (GDBusConnection       *connection,
       g_assert_not_reached ();
     }
 
+  /* direct dispatch runs the handler from the message dispatch itself,
+   * otherwise it is invoked from an idle source in a later iteration */
+  source = g_main_current_source ();
+  if (source != NULL && source->source_funcs != &g_idle_funcs)
+    data->num_direct_method_calls++;
+
   data->num_method_calls++;
 }
 
@@ -198,6 +208,7 @@ on_new_connection (GDBusServer      *server,
                                                   "org.gtk.GDBus.PeerTestInterface",
                                                   &test_interface_introspection_data,
                                                   &test_interface_vtable,
+                                                  data->register_flags,
                                                   data,
                                                   NULL, /* GDestroyNotify for data */
                                                   &error);
@@ -212,6 +223,52 @@ on_new_connection (GDBusServer      *server,
   g_main_loop_quit (loop);
 }
 
+/* a server with one accepted connection, used by most of the tests below */
+typedef struct
+{
+  PeerData data;
+  GDBusServer *server;
+  GDBusConnection *client;
+  GDBusConnection *server_connection;
+} PeerSetup;
+
+static void
+peer_setup (PeerSetup                *setup,
+            GDBusRegisterObjectFlags  register_flags)
+{
+  GError *error;
+
+  error = NULL;
+  setup->data.accept_connection = TRUE;
+  setup->data.register_flags = register_flags;
+  setup->data.num_connection_attempts = 0;
+  setup->data.current_connections = g_ptr_array_new_with_free_func (g_object_unref);
+  setup->data.num_method_calls = 0;
+  setup->data.num_direct_method_calls = 0;
+
+  setup->server = g_dbus_server_new (test_address, &error);
+  g_assert_no_error (error);
+  g_signal_connect (setup->server,
+                    "new-connection",
+                    G_CALLBACK (on_new_connection),
+                    &setup->data);
+  setup->client = g_dbus_connection_new_sync (test_address,
+                                              NULL,
+                                              &error);
+  g_assert_no_error (error);
+  g_main_loop_run (loop);
+  g_assert_cmpint (setup->data.current_connections->len, ==, 1);
+  setup->server_connection = G_DBUS_CONNECTION (setup->data.current_connections->pdata[0]);
+}
+
+static void
+peer_teardown (PeerSetup *setup)
+{
+  g_object_unref (setup->client);
+  g_object_unref (setup->server);
+  g_ptr_array_unref (setup->data.current_connections);
+}
+
 static void
 new_proxy_cb (GObject      *source_object,
               GAsyncResult *res,
@@ -272,9 +329,11 @@ test_peer (void)
   GVariant *value;
 
   error = NULL;
+  data.register_flags = G_DBUS_REGISTER_OBJECT_FLAGS_NONE;
   data.num_connection_attempts = 0;
   data.current_connections = g_ptr_array_new_with_free_func (g_object_unref);
   data.num_method_calls = 0;
+  data.num_direct_method_calls = 0;
 
   /* first try to connect when there is no server */
   c = g_dbus_connection_new_sync (test_address,
@@ -420,6 +479,856 @@ test_peer (void)
   g_ptr_array_unref (data.current_connections);
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check how signal delivery scales with the number of subscriptions (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define SIGNAL_MATCH_NUM_SUBSCRIPTIONS 10000
+#define SIGNAL_MATCH_NUM_SIGNALS       10000
+
+static void
+on_signal_match_signal (GDBusConnection  *connection,
+                        const gchar      *sender_name,
+                        const gchar      *object_path,
+                        const gchar      *interface_name,
+                        const gchar      *signal_name,
+                        GVariant         *parameters,
+                        gpointer          user_data)
+{
+  guint *num_received = user_data;
+
+  (*num_received)++;
+  if (*num_received == SIGNAL_MATCH_NUM_SIGNALS)
+    g_main_loop_quit (loop);
+}
+
+static void
+test_signal_match (void)
+{
+  GDBusConnection *c;
+  GDBusConnection *server_c;
+  GError *error;
+  PeerSetup setup;
+  guint *subscription_ids;
+  guint num_received;
+  GTimer *timer;
+  gdouble elapsed;
+  guint n;
+
+  error = NULL;
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+  c = setup.client;
+  server_c = setup.server_connection;
+
+  /* one subscription per object path - only one of them matches each signal */
+  num_received = 0;
+  subscription_ids = g_new0 (guint, SIGNAL_MATCH_NUM_SUBSCRIPTIONS);
+  for (n = 0; n < SIGNAL_MATCH_NUM_SUBSCRIPTIONS; n++)
+    {
+      gchar *object_path;
+
+      object_path = g_strdup_printf ("/org/gtk/GDBus/PeerTestObject/%d", n);
+      subscription_ids[n] = g_dbus_connection_signal_subscribe (c,
+                                                                NULL, /* sender */
+                                                                "org.gtk.GDBus.PeerTestInterface",
+                                                                "PeerSignal",
+                                                                object_path,
+                                                                NULL, /* arg0 */
+                                                                on_signal_match_signal,
+                                                                &num_received,
+                                                                NULL);
+      g_free (object_path);
+    }
+
+  timer = g_timer_new ();
+  for (n = 0; n < SIGNAL_MATCH_NUM_SIGNALS; n++)
+    {
+      gchar *object_path;
+
+      object_path = g_strdup_printf ("/org/gtk/GDBus/PeerTestObject/%d",
+                                     g_test_rand_int_range (0, SIGNAL_MATCH_NUM_SUBSCRIPTIONS));
+      g_dbus_connection_emit_signal (server_c,
+                                     NULL,
+                                     object_path,
+                                     "org.gtk.GDBus.PeerTestInterface",
+                                     "PeerSignal",
+                                     NULL,
+                                     &error);
+      g_assert_no_error (error);
+      g_free (object_path);
+    }
+  g_main_loop_run (loop);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_assert_cmpint (num_received, ==, SIGNAL_MATCH_NUM_SIGNALS);
+  g_test_minimized_result (elapsed / SIGNAL_MATCH_NUM_SIGNALS * 1e6,
+                           "%d subscriptions: %.1f usec per delivered signal",
+                           SIGNAL_MATCH_NUM_SUBSCRIPTIONS,
+                           elapsed / SIGNAL_MATCH_NUM_SIGNALS * 1e6);
+
+  for (n = 0; n < SIGNAL_MATCH_NUM_SUBSCRIPTIONS; n++)
+    g_dbus_connection_signal_unsubscribe (c, subscription_ids[n]);
+  g_free (subscription_ids);
+
+  peer_teardown (&setup);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check how fast signals with g_variant_new() parameters are emitted (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define EMIT_NUM_SIGNALS 10000
+
+static void
+on_emit_signal (GDBusConnection  *connection,
+                const gchar      *sender_name,
+                const gchar      *object_path,
+                const gchar      *interface_name,
+                const gchar      *signal_name,
+                GVariant         *parameters,
+                gpointer          user_data)
+{
+  guint *num_received = user_data;
+
+  (*num_received)++;
+  if (*num_received == EMIT_NUM_SIGNALS)
+    g_main_loop_quit (loop);
+}
+
+/* returns the time spent emitting EMIT_NUM_SIGNALS signals with (su) parameters */
+static gdouble
+time_emit_signal (GDBusConnection *emitter,
+                  gboolean         flatten,
+                  guint           *num_received)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  GError *error;
+  guint n;
+
+  *num_received = 0;
+  error = NULL;
+
+  timer = g_timer_new ();
+  for (n = 0; n < EMIT_NUM_SIGNALS; n++)
+    {
+      GVariant *parameters;
+
+      parameters = g_variant_ref_sink (g_variant_new ("(su)", "a string argument", n));
+      /* what g_variant_new() used to do */
+      if (flatten)
+        g_variant_flatten (parameters);
+
+      g_dbus_connection_emit_signal (emitter,
+                                     NULL,
+                                     "/org/gtk/GDBus/PeerTestObject",
+                                     "org.gtk.GDBus.PeerTestInterface",
+                                     "PeerSignal",
+                                     parameters,
+                                     &error);
+      g_assert_no_error (error);
+      g_variant_unref (parameters);
+    }
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_main_loop_run (loop);
+  g_assert_cmpint (*num_received, ==, EMIT_NUM_SIGNALS);
+
+  return elapsed;
+}
+
+static void
+test_emit_signal (void)
+{
+  GDBusConnection *c;
+  GDBusConnection *server_c;
+  PeerSetup setup;
+  guint subscription_id;
+  guint num_received;
+  gdouble flattened;
+  gdouble lazy;
+
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+  c = setup.client;
+  server_c = setup.server_connection;
+
+  subscription_id = g_dbus_connection_signal_subscribe (c,
+                                                        NULL, /* sender */
+                                                        "org.gtk.GDBus.PeerTestInterface",
+                                                        "PeerSignal",
+                                                        "/org/gtk/GDBus/PeerTestObject",
+                                                        NULL, /* arg0 */
+                                                        on_emit_signal,
+                                                        &num_received,
+                                                        NULL);
+
+  flattened = time_emit_signal (server_c, TRUE, &num_received);
+  lazy = time_emit_signal (server_c, FALSE, &num_received);
+
+  g_test_maximized_result (EMIT_NUM_SIGNALS / flattened,
+                           "flattened parameters: %.0f signals/sec emitted",
+                           EMIT_NUM_SIGNALS / flattened);
+  g_test_maximized_result (EMIT_NUM_SIGNALS / lazy,
+                           "tree-form parameters: %.0f signals/sec emitted",
+                           EMIT_NUM_SIGNALS / lazy);
+
+  g_dbus_connection_signal_unsubscribe (c, subscription_id);
+
+  peer_teardown (&setup);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check how fast a burst of incoming messages is drained (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define BURST_NUM_SIGNALS 10000
+
+static void
+on_burst_signal (GDBusConnection  *connection,
+                 const gchar      *sender_name,
+                 const gchar      *object_path,
+                 const gchar      *interface_name,
+                 const gchar      *signal_name,
+                 GVariant         *parameters,
+                 gpointer          user_data)
+{
+  guint *num_received = user_data;
+
+  (*num_received)++;
+  if (*num_received == BURST_NUM_SIGNALS)
+    g_main_loop_quit (loop);
+}
+
+/* returns the number of seconds it takes to receive BURST_NUM_SIGNALS signals
+ * emitted back-to-back with the receiving side using the given dispatch budget
+ */
+static gdouble
+time_burst_drain (guint max_messages)
+{
+  GDBusConnection *c;
+  GDBusConnection *server_c;
+  GError *error;
+  PeerSetup setup;
+  guint subscription_id;
+  guint num_received;
+  GTimer *timer;
+  gdouble elapsed;
+  guint n;
+
+  error = NULL;
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+  c = setup.client;
+  server_c = setup.server_connection;
+
+  g_dbus_connection_set_dispatch_budget (c, max_messages, 0);
+
+  num_received = 0;
+  subscription_id = g_dbus_connection_signal_subscribe (c,
+                                                        NULL, /* sender */
+                                                        "org.gtk.GDBus.PeerTestInterface",
+                                                        "PeerSignal",
+                                                        "/org/gtk/GDBus/PeerTestObject",
+                                                        NULL, /* arg0 */
+                                                        on_burst_signal,
+                                                        &num_received,
+                                                        NULL);
+
+  timer = g_timer_new ();
+  for (n = 0; n < BURST_NUM_SIGNALS; n++)
+    {
+      g_dbus_connection_emit_signal (server_c,
+                                     NULL,
+                                     "/org/gtk/GDBus/PeerTestObject",
+                                     "org.gtk.GDBus.PeerTestInterface",
+                                     "PeerSignal",
+                                     NULL,
+                                     &error);
+      g_assert_no_error (error);
+    }
+  g_main_loop_run (loop);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_assert_cmpint (num_received, ==, BURST_NUM_SIGNALS);
+
+  g_dbus_connection_signal_unsubscribe (c, subscription_id);
+  peer_teardown (&setup);
+
+  return elapsed;
+}
+
+static void
+test_burst_drain (void)
+{
+  gdouble one_per_iteration;
+  gdouble batched;
+
+  one_per_iteration = time_burst_drain (1);
+  batched = time_burst_drain (0);
+
+  g_test_minimized_result (one_per_iteration * 1000,
+                           "%d signals, one message per iteration: %.1f msec",
+                           BURST_NUM_SIGNALS, one_per_iteration * 1000);
+  g_test_minimized_result (batched * 1000,
+                           "%d signals, default dispatch budget: %.1f msec",
+                           BURST_NUM_SIGNALS, batched * 1000);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check method calls with and without direct dispatch - and compare the latency (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  GDBusConnection *connection;
+  guint num_calls;
+  guint num_completed;
+} DispatchData;
+
+static void invoke_hello_peer (DispatchData *data);
+
+static void
+dispatch_hello_peer_cb (GObject      *source_object,
+                        GAsyncResult *res,
+                        gpointer      user_data)
+{
+  DispatchData *data = user_data;
+  GError *error;
+  GVariant *result;
+  const gchar *s;
+
+  error = NULL;
+  result = g_dbus_connection_invoke_method_finish (data->connection, res, &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_get (result, "(s)", &s);
+  g_assert_cmpstr (s, ==, "You greeted me with 'Hey Peer!'.");
+  g_variant_unref (result);
+
+  data->num_completed++;
+  if (data->num_completed == data->num_calls)
+    g_main_loop_quit (loop);
+  else
+    invoke_hello_peer (data);
+}
+
+/* calls are made one after another so we measure the round-trip latency */
+static void
+invoke_hello_peer (DispatchData *data)
+{
+  g_dbus_connection_invoke_method (data->connection,
+                                   NULL, /* bus_name */
+                                   "/org/gtk/GDBus/PeerTestObject",
+                                   "org.gtk.GDBus.PeerTestInterface",
+                                   "HelloPeer",
+                                   g_variant_new ("(s)", "Hey Peer!"),
+                                   -1,
+                                   NULL, /* GCancellable */
+                                   dispatch_hello_peer_cb,
+                                   data);
+}
+
+/* returns the number of seconds per method call */
+static gdouble
+time_method_calls (GDBusRegisterObjectFlags register_flags,
+                   guint                    num_calls)
+{
+  PeerSetup setup;
+  DispatchData dispatch_data;
+  GTimer *timer;
+  gdouble elapsed;
+
+  peer_setup (&setup, register_flags);
+  dispatch_data.connection = setup.client;
+
+  dispatch_data.num_calls = num_calls;
+  dispatch_data.num_completed = 0;
+  timer = g_timer_new ();
+  invoke_hello_peer (&dispatch_data);
+  g_main_loop_run (loop);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_assert_cmpint (dispatch_data.num_completed, ==, num_calls);
+  g_assert_cmpint (setup.data.num_method_calls, ==, num_calls);
+  if (register_flags & G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH)
+    g_assert_cmpint (setup.data.num_direct_method_calls, ==, num_calls);
+  else
+    g_assert_cmpint (setup.data.num_direct_method_calls, ==, 0);
+
+  peer_teardown (&setup);
+
+  return elapsed / num_calls;
+}
+
+static void
+test_method_dispatch (void)
+{
+  guint num_calls;
+  gdouble idle;
+  gdouble direct;
+
+  num_calls = g_test_perf () ? 10000 : 10;
+
+  idle = time_method_calls (G_DBUS_REGISTER_OBJECT_FLAGS_NONE, num_calls);
+  direct = time_method_calls (G_DBUS_REGISTER_OBJECT_FLAGS_DIRECT_DISPATCH, num_calls);
+
+  if (g_test_perf ())
+    {
+      g_test_minimized_result (idle * 1e6, "dispatch in idle: %.1f usec per call", idle * 1e6);
+      g_test_minimized_result (direct * 1e6, "direct dispatch: %.1f usec per call", direct * 1e6);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check batched method calls - and compare start-up latency with independent calls (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  GDBusConnection *connection;
+  GDBusMethodCallBatch *batch;
+  guint num_calls;
+  guint num_completed;
+} BatchData;
+
+static void
+batch_single_call_cb (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+  BatchData *data = user_data;
+  GError *error;
+  GVariant *result;
+
+  error = NULL;
+  result = g_dbus_connection_invoke_method_finish (data->connection, res, &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_unref (result);
+
+  data->num_completed++;
+  if (data->num_completed == data->num_calls)
+    g_main_loop_quit (loop);
+}
+
+static void
+batch_cb (GObject      *source_object,
+          GAsyncResult *res,
+          gpointer      user_data)
+{
+  BatchData *data = user_data;
+  GError *error;
+  gboolean ret;
+
+  error = NULL;
+  ret = g_dbus_connection_invoke_method_batch_finish (data->connection, res, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  data->num_completed = g_dbus_method_call_batch_get_n_calls (data->batch);
+  g_main_loop_quit (loop);
+}
+
+/* returns the number of seconds it takes for all @num_calls calls to complete */
+static gdouble
+time_startup_calls (gboolean use_batch,
+                    guint    num_calls)
+{
+  GError *error;
+  PeerSetup setup;
+  BatchData batch_data;
+  GTimer *timer;
+  gdouble elapsed;
+  guint n;
+
+  error = NULL;
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+  batch_data.connection = setup.client;
+
+  batch_data.batch = NULL;
+  batch_data.num_calls = num_calls;
+  batch_data.num_completed = 0;
+  timer = g_timer_new ();
+  if (use_batch)
+    {
+      batch_data.batch = g_dbus_method_call_batch_new ();
+      for (n = 0; n < num_calls; n++)
+        g_dbus_method_call_batch_add (batch_data.batch,
+                                      NULL, /* bus_name */
+                                      "/org/gtk/GDBus/PeerTestObject",
+                                      "org.gtk.GDBus.PeerTestInterface",
+                                      "HelloPeer",
+                                      g_variant_new ("(s)", "Hey Peer!"));
+      g_dbus_connection_invoke_method_batch (batch_data.connection,
+                                             batch_data.batch,
+                                             -1,
+                                             NULL, /* GCancellable */
+                                             batch_cb,
+                                             &batch_data);
+    }
+  else
+    {
+      for (n = 0; n < num_calls; n++)
+        g_dbus_connection_invoke_method (batch_data.connection,
+                                         NULL, /* bus_name */
+                                         "/org/gtk/GDBus/PeerTestObject",
+                                         "org.gtk.GDBus.PeerTestInterface",
+                                         "HelloPeer",
+                                         g_variant_new ("(s)", "Hey Peer!"),
+                                         -1,
+                                         NULL, /* GCancellable */
+                                         batch_single_call_cb,
+                                         &batch_data);
+    }
+  g_main_loop_run (loop);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_assert_cmpint (batch_data.num_completed, ==, num_calls);
+  g_assert_cmpint (setup.data.num_method_calls, ==, num_calls);
+
+  if (batch_data.batch != NULL)
+    {
+      for (n = 0; n < num_calls; n++)
+        {
+          GVariant *result;
+          const gchar *s;
+
+          result = g_dbus_method_call_batch_get_result (batch_data.batch, n, &error);
+          g_assert_no_error (error);
+          g_assert (result != NULL);
+          g_variant_get (result, "(s)", &s);
+          g_assert_cmpstr (s, ==, "You greeted me with 'Hey Peer!'.");
+          g_variant_unref (result);
+        }
+      g_dbus_method_call_batch_unref (batch_data.batch);
+    }
+
+  peer_teardown (&setup);
+
+  return elapsed;
+}
+
+static void
+test_method_call_batch (void)
+{
+  GDBusConnection *c;
+  GDBusMethodCallBatch *batch;
+  GError *error;
+  PeerSetup setup;
+  BatchData batch_data;
+  GVariant *result;
+  const gchar *s;
+  guint hello_index;
+  guint unknown_index;
+  guint num_calls;
+  gdouble independent;
+  gdouble batched;
+
+  error = NULL;
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+  c = setup.client;
+
+  /* errors are reported per call and don't affect the other calls in the batch */
+  batch = g_dbus_method_call_batch_new ();
+  hello_index = g_dbus_method_call_batch_add (batch,
+                                              NULL, /* bus_name */
+                                              "/org/gtk/GDBus/PeerTestObject",
+                                              "org.gtk.GDBus.PeerTestInterface",
+                                              "HelloPeer",
+                                              g_variant_new ("(s)", "Hey Peer!"));
+  unknown_index = g_dbus_method_call_batch_add (batch,
+                                                NULL, /* bus_name */
+                                                "/org/gtk/GDBus/PeerTestObject",
+                                                "org.gtk.GDBus.PeerTestInterface",
+                                                "NonExistantMethod",
+                                                NULL);
+  g_assert_cmpint (g_dbus_method_call_batch_get_n_calls (batch), ==, 2);
+
+  batch_data.connection = c;
+  batch_data.batch = batch;
+  batch_data.num_calls = 2;
+  batch_data.num_completed = 0;
+  g_dbus_connection_invoke_method_batch (c,
+                                         batch,
+                                         -1,
+                                         NULL, /* GCancellable */
+                                         batch_cb,
+                                         &batch_data);
+  g_main_loop_run (loop);
+  g_assert_cmpint (batch_data.num_completed, ==, 2);
+
+  result = g_dbus_method_call_batch_get_result (batch, hello_index, &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_get (result, "(s)", &s);
+  g_assert_cmpstr (s, ==, "You greeted me with 'Hey Peer!'.");
+  g_variant_unref (result);
+
+  result = g_dbus_method_call_batch_get_result (batch, unknown_index, &error);
+  g_assert_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD);
+  g_assert (result == NULL);
+  g_error_free (error);
+  error = NULL;
+
+  g_dbus_method_call_batch_unref (batch);
+  peer_teardown (&setup);
+
+  /* compare fetching state from many objects at start-up with and without batching */
+  num_calls = g_test_perf () ? 1000 : 10;
+
+  independent = time_startup_calls (FALSE, num_calls);
+  batched = time_startup_calls (TRUE, num_calls);
+
+  if (g_test_perf ())
+    {
+      g_test_minimized_result (independent * 1000,
+                               "%d independent calls: %.1f msec", num_calls, independent * 1000);
+      g_test_minimized_result (batched * 1000,
+                               "%d batched calls: %.1f msec", num_calls, batched * 1000);
+    }
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check that calls not expecting a reply are flagged as such and do not get one */
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* the other end is a plain libdbus connection so we can see what goes over the wire */
+typedef struct
+{
+  guint num_replies;
+  dbus_uint32_t last_reply_serial;
+  guint num_pings;
+  gboolean ping_no_reply;
+} NoReplyData;
+
+static DBusHandlerResult
+no_reply_filter_func (DBusConnection *connection,
+                      DBusMessage    *message,
+                      void           *user_data)
+{
+  NoReplyData *data = user_data;
+
+  if (dbus_message_get_type (message) == DBUS_MESSAGE_TYPE_METHOD_RETURN)
+    {
+      data->num_replies++;
+      data->last_reply_serial = dbus_message_get_reply_serial (message);
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+  else if (dbus_message_is_method_call (message, "org.gtk.GDBus.NoReplyTestInterface", "Ping"))
+    {
+      data->num_pings++;
+      data->ping_no_reply = dbus_message_get_no_reply (message);
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* runs both ends since the libdbus connection is not hooked up to the main loop */
+static void
+no_reply_iteration (DBusConnection *dbus_1_connection)
+{
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+  dbus_connection_read_write_dispatch (dbus_1_connection, 10);
+}
+
+static DBusMessage *
+new_hello_peer_message (gboolean no_reply)
+{
+  DBusMessage *message;
+  const gchar *greeting;
+
+  message = dbus_message_new_method_call (NULL,
+                                          "/org/gtk/GDBus/PeerTestObject",
+                                          "org.gtk.GDBus.PeerTestInterface",
+                                          "HelloPeer");
+  g_assert (message != NULL);
+  greeting = "Hey Peer!";
+  g_assert (dbus_message_append_args (message,
+                                      DBUS_TYPE_STRING, &greeting,
+                                      DBUS_TYPE_INVALID));
+  dbus_message_set_no_reply (message, no_reply);
+
+  return message;
+}
+
+static void
+test_no_reply (void)
+{
+  GDBusServer *server;
+  GDBusConnection *server_c;
+  DBusConnection *dc;
+  DBusMessage *message;
+  DBusError dbus_error;
+  GError *error;
+  PeerData data;
+  NoReplyData no_reply_data;
+  dbus_uint32_t serial;
+
+  error = NULL;
+  data.accept_connection = TRUE;
+  data.register_flags = G_DBUS_REGISTER_OBJECT_FLAGS_NONE;
+  data.num_connection_attempts = 0;
+  data.current_connections = g_ptr_array_new_with_free_func (g_object_unref);
+  data.num_method_calls = 0;
+  data.num_direct_method_calls = 0;
+
+  server = g_dbus_server_new (test_address, &error);
+  g_assert_no_error (error);
+  g_signal_connect (server,
+                    "new-connection",
+                    G_CALLBACK (on_new_connection),
+                    &data);
+
+  dbus_error_init (&dbus_error);
+  dc = dbus_connection_open_private (test_address, &dbus_error);
+  g_assert (!dbus_error_is_set (&dbus_error));
+  g_assert (dc != NULL);
+  memset (&no_reply_data, '\0', sizeof (NoReplyData));
+  g_assert (dbus_connection_add_filter (dc, no_reply_filter_func, &no_reply_data, NULL));
+  while (data.current_connections->len < 1)
+    no_reply_iteration (dc);
+  server_c = G_DBUS_CONNECTION (data.current_connections->pdata[0]);
+
+  /**
+   * Call HelloPeer - which returns a value - once without expecting a reply and then
+   * once more expecting one. Since the server handles the calls in order, a reply to
+   * the first call would arrive before the reply to the second one.
+   */
+  message = new_hello_peer_message (TRUE);
+  g_assert (dbus_connection_send (dc, message, NULL));
+  dbus_message_unref (message);
+  message = new_hello_peer_message (FALSE);
+  g_assert (dbus_connection_send (dc, message, &serial));
+  dbus_message_unref (message);
+  while (no_reply_data.num_replies < 1)
+    no_reply_iteration (dc);
+  g_assert_cmpint (data.num_method_calls, ==, 2);
+  g_assert_cmpint (no_reply_data.num_replies, ==, 1);
+  g_assert_cmpint (no_reply_data.last_reply_serial, ==, serial);
+
+  /**
+   * A method call without a callback must carry the NO_REPLY_EXPECTED flag.
+   */
+  g_dbus_connection_invoke_method (server_c,
+                                   NULL, /* bus_name */
+                                   "/org/gtk/GDBus/NoReplyTestObject",
+                                   "org.gtk.GDBus.NoReplyTestInterface",
+                                   "Ping",
+                                   NULL, /* parameters */
+                                   -1,
+                                   NULL, /* GCancellable */
+                                   NULL, /* GAsyncReadyCallback */
+                                   NULL);
+  while (no_reply_data.num_pings < 1)
+    no_reply_iteration (dc);
+  g_assert (no_reply_data.ping_no_reply);
+
+  dbus_connection_remove_filter (dc, no_reply_filter_func, &no_reply_data);
+  dbus_connection_close (dc);
+  dbus_connection_unref (dc);
+  g_object_unref (server);
+  g_ptr_array_unref (data.current_connections);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check that signals are delivered to a nested main loop run from a signal handler */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define NESTED_NUM_SIGNALS 3
+
+typedef struct
+{
+  guint num_received;
+  GMainLoop *nested_loop;
+} NestedSignalData;
+
+static void
+on_nested_signal (GDBusConnection  *connection,
+                  const gchar      *sender_name,
+                  const gchar      *object_path,
+                  const gchar      *interface_name,
+                  const gchar      *signal_name,
+                  GVariant         *parameters,
+                  gpointer          user_data)
+{
+  NestedSignalData *data = user_data;
+
+  data->num_received++;
+  if (data->num_received == 1)
+    {
+      /* the other signals must be delivered while we are still in here */
+      data->nested_loop = g_main_loop_new (NULL, FALSE);
+      g_main_loop_run (data->nested_loop);
+      g_main_loop_unref (data->nested_loop);
+      data->nested_loop = NULL;
+      g_assert_cmpint (data->num_received, ==, NESTED_NUM_SIGNALS);
+      g_main_loop_quit (loop);
+    }
+  else if (data->num_received == NESTED_NUM_SIGNALS)
+    {
+      g_main_loop_quit (data->nested_loop);
+    }
+}
+
+static gboolean
+on_nested_signal_timeout (gpointer user_data)
+{
+  g_error ("Timed out waiting for signals in a nested main loop");
+  return FALSE;
+}
+
+static void
+test_nested_signal_delivery (void)
+{
+  PeerSetup setup;
+  NestedSignalData nested_data;
+  GError *error;
+  guint subscription_id;
+  guint timeout_id;
+  guint n;
+
+  error = NULL;
+  peer_setup (&setup, G_DBUS_REGISTER_OBJECT_FLAGS_NONE);
+
+  nested_data.num_received = 0;
+  nested_data.nested_loop = NULL;
+  subscription_id = g_dbus_connection_signal_subscribe (setup.client,
+                                                        NULL, /* sender */
+                                                        "org.gtk.GDBus.PeerTestInterface",
+                                                        "PeerSignal",
+                                                        "/org/gtk/GDBus/PeerTestObject",
+                                                        NULL, /* arg0 */
+                                                        on_nested_signal,
+                                                        &nested_data,
+                                                        NULL);
+
+  for (n = 0; n < NESTED_NUM_SIGNALS; n++)
+    {
+      g_dbus_connection_emit_signal (setup.server_connection,
+                                     NULL,
+                                     "/org/gtk/GDBus/PeerTestObject",
+                                     "org.gtk.GDBus.PeerTestInterface",
+                                     "PeerSignal",
+                                     NULL,
+                                     &error);
+      g_assert_no_error (error);
+    }
+
+  timeout_id = g_timeout_add (5 * 1000, on_nested_signal_timeout, NULL);
+  g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+  g_assert_cmpint (nested_data.num_received, ==, NESTED_NUM_SIGNALS);
+
+  g_dbus_connection_signal_unsubscribe (setup.client, subscription_id);
+  peer_teardown (&setup);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 int
@@ -438,6 +1347,16 @@ main (int   argc,
   loop = g_main_loop_new (NULL, FALSE);
 
   g_test_add_func ("/gdbus/peer-to-peer", test_peer);
+  g_test_add_func ("/gdbus/method-dispatch", test_method_dispatch);
+  g_test_add_func ("/gdbus/method-call-batch", test_method_call_batch);
+  g_test_add_func ("/gdbus/no-reply", test_no_reply);
+  g_test_add_func ("/gdbus/nested-signal-delivery", test_nested_signal_delivery);
+  if (g_test_perf ())
+    {
+      g_test_add_func ("/gdbus/signal-match", test_signal_match);
+      g_test_add_func ("/gdbus/burst-drain", test_burst_drain);
+      g_test_add_func ("/gdbus/emit-signal", test_emit_signal);
+    }
 
   ret = g_test_run();
 
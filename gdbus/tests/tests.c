@@ -129,3 +129,82 @@ _g_assert_signal_received_run (gpointer     object,
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
+
+/* returns the aggregate number of iterations per second with @num_threads threads */
+static gdouble
+run_thread_scaling (guint                  num_threads,
+                    guint                  num_iterations,
+                    TestThreadSetupFunc    setup_func,
+                    GThreadFunc            thread_func,
+                    TestThreadTeardownFunc teardown_func)
+{
+  gpointer *thread_data;
+  GThread **threads;
+  GTimer *timer;
+  gdouble elapsed;
+  guint n;
+
+  thread_data = g_new0 (gpointer, num_threads);
+  threads = g_new0 (GThread *, num_threads);
+
+  if (setup_func != NULL)
+    {
+      for (n = 0; n < num_threads; n++)
+        thread_data[n] = setup_func ();
+    }
+
+  timer = g_timer_new ();
+  for (n = 0; n < num_threads; n++)
+    {
+      GError *error;
+
+      error = NULL;
+      threads[n] = g_thread_create (thread_func,
+                                    thread_data[n],
+                                    TRUE,
+                                    &error);
+      g_assert_no_error (error);
+    }
+  for (n = 0; n < num_threads; n++)
+    g_thread_join (threads[n]);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  if (teardown_func != NULL)
+    {
+      for (n = 0; n < num_threads; n++)
+        teardown_func (thread_data[n]);
+    }
+
+  g_free (thread_data);
+  g_free (threads);
+
+  return num_threads * num_iterations / elapsed;
+}
+
+void
+_g_test_thread_scaling (const gchar           *what,
+                        guint                  num_iterations,
+                        TestThreadSetupFunc    setup_func,
+                        GThreadFunc            thread_func,
+                        TestThreadTeardownFunc teardown_func)
+{
+  gint num_threads;
+  gdouble single_rate;
+  gdouble multi_rate;
+
+  num_threads = sysconf (_SC_NPROCESSORS_ONLN);
+  if (num_threads < 2)
+    num_threads = 2;
+
+  single_rate = run_thread_scaling (1, num_iterations, setup_func, thread_func, teardown_func);
+  multi_rate = run_thread_scaling (num_threads, num_iterations, setup_func, thread_func, teardown_func);
+
+  g_test_maximized_result (single_rate, "1 thread: %.0f %s/sec", single_rate, what);
+  g_test_maximized_result (multi_rate, "%d threads: %.0f %s/sec",
+                           num_threads, multi_rate, what);
+  g_test_maximized_result (multi_rate / single_rate, "scaling with %d threads: %.2fx",
+                           num_threads, multi_rate / single_rate);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
@@ -112,6 +112,20 @@ gboolean _g_assert_property_notify_run (gpointer     object,
 gboolean _g_assert_signal_received_run (gpointer     object,
                                         const gchar *signal_name);
 
+/* Runs @thread_func in one thread and then in one thread per CPU,
+ * reporting the throughput of each and how well it scales. Each thread
+ * is passed what @setup_func returned for it (or %NULL) and must perform
+ * @num_iterations iterations; setup and teardown are not timed.
+ */
+typedef gpointer (*TestThreadSetupFunc)    (void);
+typedef void     (*TestThreadTeardownFunc) (gpointer thread_data);
+
+void _g_test_thread_scaling (const gchar           *what,
+                             guint                  num_iterations,
+                             TestThreadSetupFunc    setup_func,
+                             GThreadFunc            thread_func,
+                             TestThreadTeardownFunc teardown_func);
+
 G_END_DECLS
 
 #endif /* __TESTS_H__ */
@@ -473,6 +473,462 @@ test_method_calls_in_thread (void)
   g_bus_unwatch_proxy (watcher_id);
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+/* Ensure that method calls can be handled in the thread pool - in order if requested */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define THREAD_POOL_NUM_CALLS 200
+
+typedef struct
+{
+  GThread *main_thread;
+  gboolean in_order;
+  volatile gint num_handled;
+} ThreadPoolObject;
+
+static const GDBusArgInfo thread_pool_work_in_args[] =
+{
+  {"sequence_number", "u", NULL}
+};
+
+static const GDBusArgInfo thread_pool_work_out_args[] =
+{
+  {"sequence_number", "u", NULL}
+};
+
+static const GDBusMethodInfo thread_pool_method_info[] =
+{
+  {
+    "Work",
+    "u", 1, thread_pool_work_in_args,
+    "u", 1, thread_pool_work_out_args,
+    NULL
+  }
+};
+
+static const GDBusInterfaceInfo thread_pool_interface_info =
+{
+  "com.example.ThreadPool",
+  1, thread_pool_method_info,
+  0, NULL,
+  0, NULL,
+  NULL
+};
+
+static void
+thread_pool_method_call (GDBusConnection       *connection,
+                         gpointer               user_data,
+                         const gchar           *sender,
+                         const gchar           *object_path,
+                         const gchar           *interface_name,
+                         const gchar           *method_name,
+                         GVariant              *parameters,
+                         GDBusMethodInvocation *invocation)
+{
+  ThreadPoolObject *object = user_data;
+  guint sequence_number;
+  gint num_handled;
+
+  g_assert (g_thread_self () != object->main_thread);
+  g_assert_cmpstr (method_name, ==, "Work");
+
+  g_variant_get (parameters, "(u)", &sequence_number);
+  num_handled = g_atomic_int_exchange_and_add (&object->num_handled, 1);
+  if (object->in_order)
+    g_assert_cmpint (sequence_number, ==, num_handled);
+
+  g_dbus_method_invocation_return_value (invocation,
+                                         g_variant_new ("(u)", sequence_number));
+}
+
+static const GDBusInterfaceVTable thread_pool_vtable =
+{
+  thread_pool_method_call,
+  NULL,
+  NULL
+};
+
+static void
+thread_pool_work_cb (GObject      *source_object,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  guint *num_replies = user_data;
+  GError *error;
+  GVariant *result;
+
+  error = NULL;
+  result = g_dbus_connection_invoke_method_finish (G_DBUS_CONNECTION (source_object), res, &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_unref (result);
+
+  (*num_replies)++;
+  if (*num_replies == 2 * THREAD_POOL_NUM_CALLS)
+    g_main_loop_quit (loop);
+}
+
+static void
+test_method_calls_in_thread_pool (void)
+{
+  GDBusConnection *server_connection;
+  ThreadPoolObject ordered;
+  ThreadPoolObject unordered;
+  guint ordered_id;
+  guint unordered_id;
+  guint num_replies;
+  GError *error;
+  guint n;
+
+  error = NULL;
+  server_connection = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (server_connection != NULL);
+
+  ordered.main_thread = g_thread_self ();
+  ordered.in_order = TRUE;
+  ordered.num_handled = 0;
+  ordered_id = g_dbus_connection_register_object (server_connection,
+                                                  "/com/example/ThreadPool/Ordered",
+                                                  "com.example.ThreadPool",
+                                                  &thread_pool_interface_info,
+                                                  &thread_pool_vtable,
+                                                  G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL |
+                                                  G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_ORDER,
+                                                  &ordered,
+                                                  NULL,
+                                                  &error);
+  g_assert_no_error (error);
+  g_assert (ordered_id > 0);
+
+  unordered.main_thread = g_thread_self ();
+  unordered.in_order = FALSE;
+  unordered.num_handled = 0;
+  unordered_id = g_dbus_connection_register_object (server_connection,
+                                                    "/com/example/ThreadPool/Unordered",
+                                                    "com.example.ThreadPool",
+                                                    &thread_pool_interface_info,
+                                                    &thread_pool_vtable,
+                                                    G_DBUS_REGISTER_OBJECT_FLAGS_DISPATCH_IN_THREAD_POOL,
+                                                    &unordered,
+                                                    NULL,
+                                                    &error);
+  g_assert_no_error (error);
+  g_assert (unordered_id > 0);
+
+  /* fire off all calls at once so they pile up in the pool */
+  num_replies = 0;
+  for (n = 0; n < THREAD_POOL_NUM_CALLS; n++)
+    {
+      g_dbus_connection_invoke_method (c,
+                                       g_dbus_connection_get_unique_name (server_connection),
+                                       "/com/example/ThreadPool/Ordered",
+                                       "com.example.ThreadPool",
+                                       "Work",
+                                       g_variant_new ("(u)", n),
+                                       -1,
+                                       NULL,
+                                       thread_pool_work_cb,
+                                       &num_replies);
+      g_dbus_connection_invoke_method (c,
+                                       g_dbus_connection_get_unique_name (server_connection),
+                                       "/com/example/ThreadPool/Unordered",
+                                       "com.example.ThreadPool",
+                                       "Work",
+                                       g_variant_new ("(u)", n),
+                                       -1,
+                                       NULL,
+                                       thread_pool_work_cb,
+                                       &num_replies);
+    }
+  g_main_loop_run (loop);
+
+  g_assert_cmpint (num_replies, ==, 2 * THREAD_POOL_NUM_CALLS);
+  g_assert_cmpint (ordered.num_handled, ==, THREAD_POOL_NUM_CALLS);
+  g_assert_cmpint (unordered.num_handled, ==, THREAD_POOL_NUM_CALLS);
+
+  g_assert (g_dbus_connection_unregister_object (server_connection, ordered_id));
+  g_assert (g_dbus_connection_unregister_object (server_connection, unordered_id));
+  g_object_unref (server_connection);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Ensure that a connection doing I/O in the worker thread works without the main loop running */
+/* ---------------------------------------------------------------------------------------------------- */
+
+static const GDBusArgInfo io_worker_ping_out_args[] =
+{
+  {"response", "s", NULL}
+};
+
+static const GDBusMethodInfo io_worker_method_info[] =
+{
+  {
+    "Ping",
+    "", 0, NULL,
+    "s", 1, io_worker_ping_out_args,
+    NULL
+  }
+};
+
+static const GDBusInterfaceInfo io_worker_interface_info =
+{
+  "com.example.IOWorker",
+  1, io_worker_method_info,
+  0, NULL,
+  0, NULL,
+  NULL
+};
+
+static void
+io_worker_method_call (GDBusConnection       *connection,
+                       gpointer               user_data,
+                       const gchar           *sender,
+                       const gchar           *object_path,
+                       const gchar           *interface_name,
+                       const gchar           *method_name,
+                       GVariant              *parameters,
+                       GDBusMethodInvocation *invocation)
+{
+  GThread *handler_thread = user_data;
+
+  g_assert (g_thread_self () == handler_thread);
+  g_assert_cmpstr (method_name, ==, "Ping");
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", "Pong"));
+}
+
+static const GDBusInterfaceVTable io_worker_vtable =
+{
+  io_worker_method_call,
+  NULL,
+  NULL
+};
+
+static gpointer
+io_worker_handler_thread_func (gpointer user_data)
+{
+  GMainLoop *thread_loop = user_data;
+
+  g_main_loop_run (thread_loop);
+
+  return NULL;
+}
+
+static void
+test_io_worker_thread (void)
+{
+  GDBusConnection *server_connection;
+  GMainContext *thread_context;
+  GMainLoop *thread_loop;
+  GThread *thread;
+  GError *error;
+  GVariant *result;
+  const gchar *response;
+  guint registration_id;
+
+  /* only affects connections created from now on */
+  g_dbus_enable_io_worker_thread ();
+
+  error = NULL;
+  server_connection = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (server_connection != NULL);
+
+  /* method calls are handled in a thread of our own... */
+  thread_context = g_main_context_new ();
+  thread_loop = g_main_loop_new (thread_context, FALSE);
+  thread = g_thread_create (io_worker_handler_thread_func, thread_loop, TRUE, &error);
+  g_assert_no_error (error);
+
+  g_main_context_push_thread_default (thread_context);
+  registration_id = g_dbus_connection_register_object (server_connection,
+                                                       "/com/example/IOWorker",
+                                                       "com.example.IOWorker",
+                                                       &io_worker_interface_info,
+                                                       &io_worker_vtable,
+                                                       G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
+                                                       thread,
+                                                       NULL,
+                                                       &error);
+  g_main_context_pop_thread_default (thread_context);
+  g_assert_no_error (error);
+  g_assert (registration_id > 0);
+
+  /* ... so the call completes even though nothing runs the default main loop - which is where
+   * the server connection would otherwise be reading its socket
+   */
+  result = g_dbus_connection_invoke_method_sync (c,
+                                                 g_dbus_connection_get_unique_name (server_connection),
+                                                 "/com/example/IOWorker",
+                                                 "com.example.IOWorker",
+                                                 "Ping",
+                                                 NULL,
+                                                 5000,
+                                                 NULL,
+                                                 &error);
+  g_assert_no_error (error);
+  g_assert (result != NULL);
+  g_variant_get (result, "(&s)", &response);
+  g_assert_cmpstr (response, ==, "Pong");
+  g_variant_unref (result);
+
+  g_assert (g_dbus_connection_unregister_object (server_connection, registration_id));
+  g_object_unref (server_connection);
+
+  g_main_loop_quit (thread_loop);
+  g_thread_join (thread);
+  g_main_loop_unref (thread_loop);
+  g_main_context_unref (thread_context);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check that synchronous calls waiting for the I/O worker thread still time out and can be cancelled */
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gpointer
+cancel_in_thread_func (gpointer user_data)
+{
+  GCancellable *cancellable = G_CANCELLABLE (user_data);
+
+  g_usleep (100 * 1000);
+  g_cancellable_cancel (cancellable);
+
+  return NULL;
+}
+
+static void
+test_io_worker_sync_call_timeout_and_cancel (void)
+{
+  GDBusConnection *connection;
+  GCancellable *cancellable;
+  GThread *thread;
+  GVariant *result;
+  GError *error;
+  GTimer *timer;
+
+  /* created after g_dbus_enable_io_worker_thread() was called by the previous test */
+  error = NULL;
+  connection = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (connection != NULL);
+
+  /* the server sleeps for longer than we are willing to wait */
+  timer = g_timer_new ();
+  result = g_dbus_connection_invoke_method_sync (connection,
+                                                 "com.example.TestService",
+                                                 "/com/example/TestObject",
+                                                 "com.example.Frob",
+                                                 "Sleep",
+                                                 g_variant_new ("(i)", 5000),
+                                                 200,
+                                                 NULL,
+                                                 &error);
+  g_assert_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY);
+  g_assert (result == NULL);
+  g_error_free (error);
+  error = NULL;
+  g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 2.0);
+
+  /* cancel from another thread while we are waiting */
+  cancellable = g_cancellable_new ();
+  thread = g_thread_create (cancel_in_thread_func, cancellable, TRUE, &error);
+  g_assert_no_error (error);
+  g_timer_start (timer);
+  result = g_dbus_connection_invoke_method_sync (connection,
+                                                 "com.example.TestService",
+                                                 "/com/example/TestObject",
+                                                 "com.example.Frob",
+                                                 "Sleep",
+                                                 g_variant_new ("(i)", 5000),
+                                                 -1,
+                                                 cancellable,
+                                                 &error);
+  g_assert_error (error, G_DBUS_ERROR, G_DBUS_ERROR_CANCELLED);
+  g_assert (result == NULL);
+  g_error_free (error);
+  g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 2.0);
+  g_thread_join (thread);
+  g_object_unref (cancellable);
+
+  g_timer_destroy (timer);
+  g_object_unref (connection);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+/* Check that threads using separate connections do not contend on a shared lock (perf only) */
+/* ---------------------------------------------------------------------------------------------------- */
+
+#define CONTENTION_NUM_ITERATIONS 20000
+
+static const GDBusInterfaceInfo contention_interface_info =
+{
+  "com.example.Contention",
+  0, NULL,
+  0, NULL,
+  0, NULL,
+  NULL
+};
+
+static const GDBusInterfaceVTable contention_vtable =
+{
+  NULL,
+  NULL,
+  NULL
+};
+
+static gpointer
+test_connection_contention_thread_func (gpointer user_data)
+{
+  GDBusConnection *connection = G_DBUS_CONNECTION (user_data);
+  GError *error;
+  guint registration_id;
+  guint n;
+
+  for (n = 0; n < CONTENTION_NUM_ITERATIONS; n++)
+    {
+      error = NULL;
+      registration_id = g_dbus_connection_register_object (connection,
+                                                           "/com/example/Contention",
+                                                           "com.example.Contention",
+                                                           &contention_interface_info,
+                                                           &contention_vtable,
+                                                           G_DBUS_REGISTER_OBJECT_FLAGS_NONE,
+                                                           NULL,
+                                                           NULL,
+                                                           &error);
+      g_assert_no_error (error);
+      g_assert (registration_id > 0);
+      g_assert (g_dbus_connection_unregister_object (connection, registration_id));
+    }
+
+  return NULL;
+}
+
+/* each thread uses its own private connection */
+static gpointer
+test_connection_contention_setup (void)
+{
+  GDBusConnection *connection;
+  GError *error;
+
+  error = NULL;
+  connection = g_dbus_connection_bus_get_private_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (connection != NULL);
+
+  return connection;
+}
+
+static void
+test_connection_contention (void)
+{
+  _g_test_thread_scaling ("register/unregister cycles",
+                          CONTENTION_NUM_ITERATIONS,
+                          test_connection_contention_setup,
+                          test_connection_contention_thread_func,
+                          g_object_unref);
+}
+
 /* ---------------------------------------------------------------------------------------------------- */
 
 int
@@ -517,6 +973,12 @@ main (int   argc,
 
   g_test_add_func ("/gdbus/delivery-in-thread", test_delivery_in_thread);
   g_test_add_func ("/gdbus/method-calls-in-thread", test_method_calls_in_thread);
+  g_test_add_func ("/gdbus/method-calls-in-thread-pool", test_method_calls_in_thread_pool);
+  if (g_test_perf ())
+    g_test_add_func ("/gdbus/connection-contention", test_connection_contention);
+  /* these must be the last tests since they change how new connections do I/O */
+  g_test_add_func ("/gdbus/io-worker-thread", test_io_worker_thread);
+  g_test_add_func ("/gdbus/io-worker-sync-call-timeout-and-cancel", test_io_worker_sync_call_timeout_and_cancel);
 
   ret = g_test_run();
 